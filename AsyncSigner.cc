@@ -0,0 +1,96 @@
+#include "tls/AsyncSigner.h"
+#include "tls/ServerKeyExchange.h"
+#include "tls/exceptions/BadParameterException.h"
+
+namespace CKTLS {
+
+// Static initialization.
+const unsigned AsyncSigner::DEFAULT_THREADS = 2;
+
+AsyncSigner::AsyncSigner(unsigned threads)
+: stopping(false),
+  signatures(0) {
+
+    if (threads == 0) {
+        throw BadParameterException("Invalid signing thread count");
+    }
+
+    for (unsigned i = 0; i < threads; ++i) {
+        workers.push_back(std::thread(&AsyncSigner::work, this));
+    }
+
+}
+
+/*
+ * Requests still queued are signed before the threads exit.
+ */
+AsyncSigner::~AsyncSigner() {
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (unsigned i = 0; i < workers.size(); ++i) {
+        workers[i].join();
+    }
+
+}
+
+unsigned AsyncSigner::getQueueLength() {
+
+    std::lock_guard<std::mutex> guard(lock);
+    return requests.size();
+
+}
+
+uint64_t AsyncSigner::getSignatures() const {
+
+    return signatures.load(std::memory_order_relaxed);
+
+}
+
+void AsyncSigner::submit(const coder::ByteArray& data, const Callback& done) {
+
+    Request request;
+    request.data = data;
+    request.done = done;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        requests.push_back(request);
+    }
+    ready.notify_one();
+
+}
+
+void AsyncSigner::work() {
+
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        while (requests.size() == 0 && !stopping) {
+            ready.wait(guard);
+        }
+        if (requests.size() == 0) {
+            return;
+        }
+
+        Request request(requests.front());
+        requests.pop_front();
+        guard.unlock();
+
+        coder::ByteArray signature;
+        try {
+            signature = ServerKeyExchange::sign(request.data);
+        }
+        catch (std::exception& e) {
+            signature.clear();
+        }
+        request.done(signature);
+        signatures.fetch_add(1, std::memory_order_relaxed);
+
+        guard.lock();
+    }
+
+}
+
+}
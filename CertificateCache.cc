@@ -0,0 +1,151 @@
+#include "tls/CertificateCache.h"
+#include "tls/PGPCertificate.h"
+#include "tls/exceptions/BadParameterException.h"
+#include <CryptoKitty-C/digest/SHA256.h>
+
+namespace CKTLS {
+
+// Static initialization.
+const unsigned CertificateCache::DEFAULT_SIZE = 64;
+
+CertificateCache::CertificateCache(unsigned size)
+: maxCertificates(size),
+  hits(0),
+  misses(0) {
+
+    if (maxCertificates == 0) {
+        throw BadParameterException("Invalid certificate cache size");
+    }
+
+}
+
+CertificateCache::~CertificateCache() {
+}
+
+void CertificateCache::add(const CertificatePtr& cert) {
+
+    Entry entry(makeEntry(cert, cert->encode()));
+    std::lock_guard<std::mutex> guard(lock);
+    insert(entry);
+
+}
+
+/*
+ * The certificate is parsed outside of the lock. If another thread
+ * parses the same certificate first, its copy is kept.
+ */
+CertificateCache::CachedCertificate
+CertificateCache::decode(const coder::ByteArray& encoded) {
+
+    CK::SHA256 sha256;
+    std::string digest(makeKey(sha256.digest(encoded)));
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        EntryMap::iterator it = digests.find(digest);
+        if (it != digests.end()) {
+            hits++;
+            entries.splice(entries.begin(), entries, it->second);
+            return it->second->value;
+        }
+        misses++;
+    }
+
+    CertificatePtr cert(new PGPCertificate(encoded));
+    Entry entry(makeEntry(cert, coder::ByteArray()));
+    entry.digest = digest;
+    std::lock_guard<std::mutex> guard(lock);
+    return insert(entry);
+
+}
+
+CertificateCache::CachedCertificate
+CertificateCache::find(const coder::ByteArray& fingerprint) {
+
+    std::string key(makeKey(fingerprint));
+    std::lock_guard<std::mutex> guard(lock);
+    EntryMap::iterator it = fingerprints.find(key);
+    if (it == fingerprints.end()) {
+        misses++;
+        CachedCertificate empty = { 0, 0 };
+        return empty;
+    }
+    hits++;
+    entries.splice(entries.begin(), entries, it->second);
+    return it->second->value;
+
+}
+
+uint64_t CertificateCache::getHits() const {
+
+    std::lock_guard<std::mutex> guard(lock);
+    return hits;
+
+}
+
+uint64_t CertificateCache::getMisses() const {
+
+    std::lock_guard<std::mutex> guard(lock);
+    return misses;
+
+}
+
+/*
+ * Must be called with the lock held. A certificate with the same
+ * encoding is kept; one with the same fingerprint is replaced.
+ */
+CertificateCache::CachedCertificate CertificateCache::insert(const Entry& entry) {
+
+    EntryMap::iterator it = digests.find(entry.digest);
+    if (it != digests.end()) {
+        entries.splice(entries.begin(), entries, it->second);
+        return it->second->value;
+    }
+
+    it = fingerprints.find(entry.fingerprint);
+    if (it != fingerprints.end()) {
+        EntryList::iterator old = it->second;
+        digests.erase(old->digest);
+        fingerprints.erase(it);
+        entries.erase(old);
+    }
+
+    while (entries.size() >= maxCertificates) {
+        Entry& last(entries.back());
+        fingerprints.erase(last.fingerprint);
+        digests.erase(last.digest);
+        entries.pop_back();
+    }
+
+    entries.push_front(entry);
+    fingerprints[entry.fingerprint] = entries.begin();
+    digests[entry.digest] = entries.begin();
+    return entry.value;
+
+}
+
+CertificateCache::Entry CertificateCache::makeEntry(const CertificatePtr& cert,
+                                        const coder::ByteArray& encoded) {
+
+    Entry entry;
+    entry.value.cert = cert;
+    entry.value.publicKey = cert->getPublicKey()->getRSAPublicKey();
+    entry.fingerprint = makeKey(cert->getFingerprint());
+    if (encoded.getLength() > 0) {
+        CK::SHA256 sha256;
+        entry.digest = makeKey(sha256.digest(encoded));
+    }
+    return entry;
+
+}
+
+std::string CertificateCache::makeKey(const coder::ByteArray& bytes) {
+
+    std::string key;
+    for (unsigned i = 0; i < bytes.getLength(); ++i) {
+        key.push_back(bytes[i]);
+    }
+    return key;
+
+}
+
+}
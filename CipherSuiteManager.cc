@@ -144,5 +144,11 @@ void CipherSuiteManager::setPreferred(CipherSuite suite) {
 
 }
 
+void CipherSuiteManager::setServerPreferred(const CipherSuiteList& list) {
+
+    preferred = list;
+
+}
+
 }
 
@@ -1,22 +1,34 @@
 #include "tls/CipherText.h"
 #include "tls/ConnectionState.h"
 #include "tls/exceptions/RecordException.h"
-#include <coder/Unsigned16.h>
-#include <coder/Unsigned64.h>
-#include <CryptoKitty-C/cipher/AES.h>
 #include <CryptoKitty-C/ciphermodes/GCM.h>
 
 namespace CKTLS {
 
 static const uint32_t AEAD_TAGLENGTH = 16;
+// Explicit part of the GCM nonce, sent ahead of the ciphertext.
+static const uint32_t AEAD_NONCELENGTH = 8;
+
+/*
+ * Write the sequence number as 8 bytes, big endian.
+ */
+static void encodeSequence(ConnectionState *state, uint8_t *out) {
+
+    uint64_t sequence = state->getSequenceNumber();
+    for (int i = 7; i >= 0; --i) {
+        out[i] = sequence & 0xff;
+        sequence = sequence >> 8;
+    }
+
+}
 
 #ifdef _TLS_THREAD_LOCAL_
-CipherText::CipherText()
-: RecordProtocol(application_data) {
+CipherText::CipherText(ContentType type)
+: RecordProtocol(type) {
 }
 #else
-CipherText::CipherText(StateContainer *h)
-: RecordProtocol(application_data),
+CipherText::CipherText(StateContainer *h, ContentType type)
+: RecordProtocol(type),
   holder(h) {
 }
 #endif
@@ -24,6 +36,24 @@ CipherText::CipherText(StateContainer *h)
 CipherText::~CipherText() {
 }
 
+/*
+ * Build the AEAD additional data for a record of the given
+ * plaintext length. See RFC 5246 Section 6.2.3.3.
+ */
+coder::ByteArray CipherText::authData(ConnectionState *state, uint16_t length) const {
+
+    uint8_t ad[13];
+    encodeSequence(state, ad);
+    ad[8] = content;
+    ad[9] = 3;
+    ad[10] = 3;
+    ad[11] = length >> 8;
+    ad[12] = length & 0xff;
+
+    return coder::ByteArray(ad, sizeof(ad));
+
+}
+
 void CipherText::decode() {
 
 #ifdef _TLS_THREAD_LOCAL_
@@ -32,19 +62,9 @@ void CipherText::decode() {
     ConnectionState *state = holder->getCurrentWrite();
 #endif
 
-    CK::Cipher *cipher;
-    uint32_t keyLength = state->getEncryptionKeyLength() / 8;
-    switch (state->getCipherAlgorithm()) {
-        case aes:
-            cipher = new CK::AES(static_cast<CK::AES::KeySize>(keyLength));
-            break;
-        default:
-            throw RecordException("Invalid cipher algorithm");
-    }
-
     switch (state->getCipherType()) {
         case aead:
-            decryptGCM(cipher);
+            decryptGCM(state);
             break;
         default:
             throw RecordException("Invalid cipher mode");
@@ -52,7 +72,15 @@ void CipherText::decode() {
 
 }
 
-void CipherText::decryptGCM(CK::Cipher *cipher) {
+/*
+ * Decrypt a record back into its own buffer. The record buffer must
+ * begin with the 5 byte header. CK::GCM works on ByteArrays, so the
+ * ciphertext is staged in one and the plaintext comes back in
+ * another, which is then copied over the ciphertext. The returned
+ * view points into the buffer. Neither staging copy is kept by this
+ * object.
+ */
+RecordView CipherText::decodeInPlace(uint8_t *record, unsigned length) {
 
 #ifdef _TLS_THREAD_LOCAL_
     ConnectionState *state = ConnectionState::getCurrentWrite();
@@ -60,21 +88,53 @@ void CipherText::decryptGCM(CK::Cipher *cipher) {
     ConnectionState *state = holder->getCurrentWrite();
 #endif
 
-    coder::ByteArray key(state->getEncryptionKey());
-    coder::ByteArray iv(state->getIV());
-    CK::GCM gcm(cipher, iv);
+    if (length < HEADER_LENGTH + AEAD_NONCELENGTH + AEAD_TAGLENGTH) {
+        throw RecordException("Invalid record length");
+    }
+    if (record[0] != content) {
+        throw RecordException("Invalid ciphertext content type");
+    }
+    recordMajorVersion = record[1];
+    recordMinorVersion = record[2];
+    fragLength = (record[3] << 8) | record[4];
+    if (fragLength != length - HEADER_LENGTH) {
+        throw RecordException("Invalid fragment length");
+    }
 
-    coder::ByteArray ad;
-    coder::Unsigned64 u64(state->getSequenceNumber());
-    ad.append(u64.getEncoded(coder::bigendian));
-    ad.append(CKTLS::application_data);
-    ad.append(3);
-    ad.append(3);
-    coder::Unsigned16 u16(fragment.getLength() - AEAD_TAGLENGTH);
-    ad.append(u16.getEncoded(coder::bigendian));
+    if (state->getCipherType() != aead) {
+        throw RecordException("Invalid cipher mode");
+    }
+
+    RecordView view;
+    view.data = record + HEADER_LENGTH + AEAD_NONCELENGTH;
+    view.length = fragLength - AEAD_NONCELENGTH - AEAD_TAGLENGTH;
+    coder::ByteArray nonce(state->getIV());
+    nonce.append(record + HEADER_LENGTH, AEAD_NONCELENGTH);
+    coder::ByteArray ciphertext;
+    ciphertext.append(view.data, fragLength - AEAD_NONCELENGTH);
+    CK::GCM gcm(state->getAEADCipher(), nonce);
+    gcm.setAuthData(authData(state, view.length));
+    copyOut(gcm.decrypt(ciphertext, state->getEncryptionKey()),
+                                view.data, fragLength - AEAD_NONCELENGTH);
 
-    gcm.setAuthData(ad);
-    plaintext = gcm.decrypt(fragment, key);
+    return view;
+
+}
+
+void CipherText::decryptGCM(ConnectionState *state) {
+
+    unsigned length = fragment.getLength();
+    if (length < AEAD_NONCELENGTH + AEAD_TAGLENGTH) {
+        throw RecordException("Invalid ciphertext");
+    }
+
+    coder::ByteArray nonce(state->getIV());
+    nonce.append(fragment.range(0, AEAD_NONCELENGTH));
+    CK::GCM gcm(state->getAEADCipher(), nonce);
+    gcm.setAuthData(authData(state,
+                        length - AEAD_NONCELENGTH - AEAD_TAGLENGTH));
+    plaintext = gcm.decrypt(fragment.range(AEAD_NONCELENGTH,
+                        length - AEAD_NONCELENGTH), state->getEncryptionKey());
 
 }
 
@@ -88,19 +148,9 @@ void CipherText::encode() {
 
     fragment.clear();
 
-    CK::Cipher *cipher;
-    uint32_t keyLength = state->getEncryptionKeyLength() / 8;
-    switch (state->getCipherAlgorithm()) {
-        case aes:
-            cipher = new CK::AES(static_cast<CK::AES::KeySize>(keyLength));
-            break;
-        default:
-            throw RecordException("Invalid cipher algorithm");
-    }
-
     switch (state->getCipherType()) {
         case aead:
-            encryptGCM(cipher);
+            encryptGCM(state);
             break;
         default:
             throw RecordException("Invalid cipher mode");
@@ -108,7 +158,13 @@ void CipherText::encode() {
 
 }
 
-void CipherText::encryptGCM(CK::Cipher *cipher) {
+/*
+ * Encrypt straight into the record buffer. The explicit nonce is the
+ * record sequence number, so it is never repeated under one key. See
+ * RFC 5288 Section 3. The ciphertext and tag are copied once from the
+ * cipher output and never staged in the fragment.
+ */
+unsigned CipherText::encodeFragment(uint8_t *buffer, unsigned length) {
 
 #ifdef _TLS_THREAD_LOCAL_
     ConnectionState *state = ConnectionState::getCurrentRead();
@@ -116,23 +172,39 @@ void CipherText::encryptGCM(CK::Cipher *cipher) {
     ConnectionState *state = holder->getCurrentRead();
 #endif
 
-    coder::ByteArray key(state->getEncryptionKey());
-    coder::ByteArray iv(state->getIV());
-    CK::GCM gcm(cipher, iv);
-
-    coder::ByteArray ad;
-    coder::Unsigned64 u64(state->getSequenceNumber());
-    ad.append(u64.getEncoded(coder::bigendian));
-    ad.append(CKTLS::application_data);
-    ad.append(3);
-    ad.append(3);
-    coder::Unsigned16 u16(plaintext.getLength());
-    ad.append(u16.getEncoded(coder::bigendian));
+    if (plaintext.getLength() + AEAD_NONCELENGTH + AEAD_TAGLENGTH > length) {
+        throw RecordException("Record buffer too small");
+    }
 
-    gcm.setAuthData(ad);
-    fragment.append(gcm.encrypt(plaintext, key));
+    switch (state->getCipherType()) {
+        case aead:
+            {
+            encodeSequence(state, buffer);
+            coder::ByteArray nonce(state->getLocalIV());
+            nonce.append(buffer, AEAD_NONCELENGTH);
+            CK::GCM gcm(state->getAEADCipher(), nonce);
+            gcm.setAuthData(authData(state, plaintext.getLength()));
+            return AEAD_NONCELENGTH + copyOut(gcm.encrypt(plaintext,
+                            state->getLocalKey()), buffer + AEAD_NONCELENGTH,
+                            length - AEAD_NONCELENGTH);
+            }
+        default:
+            throw RecordException("Invalid cipher mode");
+    }
 
 }
 
+void CipherText::encryptGCM(ConnectionState *state) {
+
+    uint8_t explicitPart[AEAD_NONCELENGTH];
+    encodeSequence(state, explicitPart);
+    coder::ByteArray nonce(state->getLocalIV());
+    nonce.append(explicitPart, AEAD_NONCELENGTH);
+    CK::GCM gcm(state->getAEADCipher(), nonce);
+    gcm.setAuthData(authData(state, plaintext.getLength()));
+    fragment.append(explicitPart, AEAD_NONCELENGTH);
+    fragment.append(gcm.encrypt(plaintext, state->getLocalKey()));
+
 }
 
+}
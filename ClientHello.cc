@@ -32,6 +32,12 @@ ClientHello::ClientHello(const ClientHello& other)
 ClientHello::~ClientHello() {
 }
 
+void ClientHello::addExtension(const Extension& ext) {
+
+    extensions.addExtension(ext);
+
+}
+
 #ifdef _DEBUG
 void ClientHello::debugOut(std::ostream& out) {
 
@@ -162,6 +168,12 @@ const coder::ByteArray& ClientHello::getRandom() const {
 
 }
 
+const coder::ByteArray& ClientHello::getSessionID() const {
+
+    return sessionID;
+
+}
+
 void ClientHello::initState() {
 
     gmt = time(0);
@@ -173,4 +185,16 @@ void ClientHello::initState() {
 
 }
 
+/*
+ * Sets the session ID. Session IDs are at most 32 bytes.
+ */
+void ClientHello::setSessionID(const coder::ByteArray& id) {
+
+    if (id.getLength() > 32) {
+        throw RecordException("Invalid session ID length");
+    }
+    sessionID = id;
+
+}
+
 }
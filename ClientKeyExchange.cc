@@ -1,22 +1,32 @@
 #include "tls/ClientKeyExchange.h"
+#include "tls/ConnectionState.h"
 #include "coder/Unsigned16.h"
 #include "tls/exceptions/RecordException.h"
 #include "tls/exceptions/EncodingException.h"
 
 namespace CKTLS {
 
-// Static initialization.
-KeyExchangeAlgorithm ClientKeyExchange::algorithm;
-
+#ifdef _TLS_THREAD_LOCAL_
 ClientKeyExchange::ClientKeyExchange() {
 }
+#else
+ClientKeyExchange::ClientKeyExchange(StateContainer *h)
+: holder(h) {
+}
+#endif
 
 ClientKeyExchange::~ClientKeyExchange() {
 }
 
 void ClientKeyExchange::decode() {
 
-    switch (algorithm) {
+#ifdef _TLS_THREAD_LOCAL_
+    ConnectionState *state = ConnectionState::getPendingWrite();
+#else
+    ConnectionState *state = holder->getPendingWrite();
+#endif
+
+    switch (state->getKeyExchangeAlgorithm()) {
         case dhe_rsa:
             decodeDH(encoded);
             break;
@@ -36,12 +46,29 @@ void ClientKeyExchange::decodeDH(const coder::ByteArray& encoded) {
 
 }
 
+/*
+ * RFC 4492 ClientECDiffieHellmanPublic. The point is preceded by a
+ * one byte length.
+ */
 void ClientKeyExchange::decodeECDH(const coder::ByteArray& encoded) {
+
+        uint8_t length = encoded[0];
+        if (length == 0 || length + 1U != encoded.getLength()) {
+            throw EncodingException("Invalid EC public key length");
+        }
+        ecPublicKey = encoded.range(1, length);
+
 }
 
 const coder::ByteArray& ClientKeyExchange::encode() {
 
-    switch (algorithm) {
+#ifdef _TLS_THREAD_LOCAL_
+    ConnectionState *state = ConnectionState::getPendingRead();
+#else
+    ConnectionState *state = holder->getPendingRead();
+#endif
+
+    switch (state->getKeyExchangeAlgorithm()) {
         case dhe_rsa:
             encoded.append(encodeDH());
             break;
@@ -73,6 +100,12 @@ coder::ByteArray ClientKeyExchange::encodeECDH() const {
 
     coder::ByteArray encoded;
 
+    if (ecPublicKey.getLength() == 0 || ecPublicKey.getLength() > 0xff) {
+        throw RecordException("Invalid EC public key");
+    }
+    encoded.append(ecPublicKey.getLength());
+    encoded.append(ecPublicKey);
+
     return encoded;
 
 }
@@ -97,7 +130,6 @@ void ClientKeyExchange::initState(const CK::BigInteger& pk) {
 
 void ClientKeyExchange::initState(NamedCurve curve, const coder::ByteArray& pk) {
 
-    algorithm = ec_diffie_hellman;
     curveType = named_curve;
     named = curve;
     ecPublicKey = pk;
@@ -107,7 +139,6 @@ void ClientKeyExchange::initState(NamedCurve curve, const coder::ByteArray& pk)
 void ClientKeyExchange::initState(const CK::ECDHKeyExchange::CurveParams& params,
                                                     const coder::ByteArray& pk) {
 
-    algorithm = ec_diffie_hellman;
     curveType = explicit_prime;
 
     primeP = params.p;
@@ -122,10 +153,4 @@ void ClientKeyExchange::initState(const CK::ECDHKeyExchange::CurveParams& params
 
 }
 
-void ClientKeyExchange::setAlgorithm(KeyExchangeAlgorithm alg) {
-
-    algorithm = alg;
-
-}
-
 }
@@ -1,8 +1,8 @@
 #include "tls/ConnectionState.h"
+#include "tls/PRF.h"
 #include "tls/exceptions/StateException.h"
 #include "tls/exceptions/BadParameterException.h"
-#include <CryptoKitty-C/digest/SHA256.h>
-#include <CryptoKitty-C/mac/HMAC.h>
+#include <CryptoKitty-C/cipher/AES.h>
 #include <iostream>
 
 #ifdef _TLS_THREAD_LOCAL_
@@ -24,17 +24,26 @@ typedef cthread::TypedThreadLocal<ConnectionState> LocalConnectionState;
 ConnectionState::ConnectionState()
 : initialized(false),
   prf(tls_prf_sha256),
+  suite(TLS_NULL_WITH_NULL_NULL),
+  cipher(bca_null),
+  mode(stream),
   compression(cm_null),
-  sequenceNumber(0) {
+  sequenceNumber(0),
+  aeadCipher(0) {
 }
 
 ConnectionState::~ConnectionState() {
+
+    delete aeadCipher;
+
 }
 
 ConnectionState::ConnectionState(const ConnectionState& other)
 : initialized(false),
   entity(other.entity),
   prf(other.prf),
+  suite(other.suite),
+  keyExchange(other.keyExchange),
   cipher(other.cipher),
   mode(other.mode),
   mac(other.mac),
@@ -54,54 +63,121 @@ ConnectionState::ConnectionState(const ConnectionState& other)
   serverWriteKey(other.serverWriteKey),
   clientWriteIV(other.clientWriteIV),
   serverWriteIV(other.serverWriteIV),
-  sequenceNumber(0) {
+  sequenceNumber(0),
+  aeadCipher(0) {
   }
 
+/*
+ * Create the block cipher for this key set. The object is reused for
+ * every record protected with this state, which saves its
+ * allocation. The CK cipher API takes the key on every call, so the
+ * AES key schedule and the GCM hash key are still derived per record.
+ * The GCM context can't be kept, since each record has its own nonce.
+ */
+void ConnectionState::createAEADCipher() {
+
+    delete aeadCipher;
+    aeadCipher = 0;
+
+    if (mode != aead) {
+        return;
+    }
+
+    switch (cipher) {
+        case aes:
+            switch (encryptionKeyLength) {
+                case 16:
+                    aeadCipher = new CK::AES(CK::AES::AES128);
+                    break;
+                case 32:
+                    aeadCipher = new CK::AES(CK::AES::AES256);
+                    break;
+                default:
+                    throw StateException("Invalid AES key size");
+            }
+            break;
+        default:
+            throw StateException("Invalid AEAD cipher algorithm");
+    }
+
+}
+
+// Largest key block. 64 byte MAC keys, 32 byte encryption keys and
+// 16 byte IVs for each side.
+static const unsigned MAX_KEY_BLOCK = (64 + 32 + 16) * 2;
+
 /*
  * Generate the master secret and the client and server write keys.
  */
 void ConnectionState::generateKeys(const coder::ByteArray& premasterSecret) {
 
-    masterSecret.clear();
-    CK::HMAC prf(new CK::SHA256);
-    prf.setKey(premasterSecret);
-    coder::ByteArray seed("master secret");
-    seed.append(clientRandom);
+    uint8_t master[48];
+    PRF keyPRF(prf);
+
+    keyPRF.setSecret(premasterSecret);
+    coder::ByteArray seed(clientRandom);
     seed.append(serverRandom);
-    prf.setMessage(seed);
-    coder::ByteArray phash(prf.getHMAC());
-    masterSecret.append(phash);
-    while (masterSecret.getLength() < 48) {
-        prf.setMessage(phash);
-        phash = prf.getHMAC();
-        masterSecret.append(phash);
-    }
-    masterSecret = masterSecret.range(0, 48);
+    keyPRF.generate("master secret", seed, master, sizeof(master));
+    masterSecret.clear();
+    masterSecret.append(master, sizeof(master));
     //std::cout << "Master Secret = " << masterSecret << std::endl;
 
-    prf.setKey(masterSecret);
+    generateKeyBlock();
+
+}
+
+/*
+ * Generate the client and server write keys from the master secret.
+ */
+void ConnectionState::generateKeyBlock() {
+
+    uint8_t block[MAX_KEY_BLOCK];
+    PRF keyPRF(prf);
+
     unsigned keyLength = (encryptionKeyLength + fixedIVLength
                                                 + macKeyLength) * 2;
-    seed = "key expansion";
-    seed.append(serverRandom);
+    if (keyLength > MAX_KEY_BLOCK) {
+        throw StateException("Invalid key block length");
+    }
+    keyPRF.setSecret(masterSecret);
+    coder::ByteArray seed(serverRandom);
     seed.append(clientRandom);
-    prf.setMessage(seed);
-    phash = prf.getHMAC();
-    coder::ByteArray keyBytes(phash);
-    while (keyBytes.getLength() < keyLength) {
-        prf.setMessage(phash);
-        phash = prf.getHMAC();
-        keyBytes.append(phash);
+    keyPRF.generate("key expansion", seed, block, keyLength);
+
+    uint8_t *keyBytes = block;
+    clientWriteMACKey.clear();
+    clientWriteMACKey.append(keyBytes, macKeyLength);
+    keyBytes += macKeyLength;
+    serverWriteMACKey.clear();
+    serverWriteMACKey.append(keyBytes, macKeyLength);
+    keyBytes += macKeyLength;
+    clientWriteKey.clear();
+    clientWriteKey.append(keyBytes, encryptionKeyLength);
+    keyBytes += encryptionKeyLength;
+    serverWriteKey.clear();
+    serverWriteKey.append(keyBytes, encryptionKeyLength);
+    keyBytes += encryptionKeyLength;
+    serverWriteIV.clear();
+    serverWriteIV.append(keyBytes, fixedIVLength);
+    keyBytes += fixedIVLength;
+    clientWriteIV.clear();
+    clientWriteIV.append(keyBytes, fixedIVLength);
+
+    createAEADCipher();
+
+}
+
+/*
+ * Returns the prepared AEAD cipher. Throws StateException if the
+ * keys have not been generated.
+ */
+CK::Cipher *ConnectionState::getAEADCipher() const {
+
+    if (aeadCipher == 0) {
+        throw StateException("AEAD cipher not initialized");
     }
-    clientWriteMACKey = keyBytes.range(0, macKeyLength);
-    serverWriteMACKey = keyBytes.range(macKeyLength, macKeyLength);
-    clientWriteKey = keyBytes.range(macKeyLength*2, encryptionKeyLength);
-    serverWriteKey = keyBytes.range((macKeyLength*2)+encryptionKeyLength,
-                                                encryptionKeyLength);
-    serverWriteIV = keyBytes.range((macKeyLength*2)+(encryptionKeyLength*2),
-                                                fixedIVLength);
-    clientWriteIV = keyBytes.range((macKeyLength*2)+(encryptionKeyLength*2)
-                                                +fixedIVLength,fixedIVLength);
+
+    return aeadCipher;
 
 }
 
@@ -111,6 +187,12 @@ BulkCipherAlgorithm ConnectionState::getCipherAlgorithm() const {
 
 }
 
+CipherSuite ConnectionState::getCipherSuite() const {
+
+    return suite;
+
+}
+
 CipherType ConnectionState::getCipherType() const {
 
     return mode;
@@ -163,6 +245,18 @@ const coder::ByteArray& ConnectionState::getIV() const {
 
 }
 
+const coder::ByteArray& ConnectionState::getLocalIV() const {
+
+    return entity == server ? serverWriteIV : clientWriteIV;
+
+}
+
+const coder::ByteArray& ConnectionState::getLocalKey() const {
+
+    return entity == server ? serverWriteKey : clientWriteKey;
+
+}
+
 const coder::ByteArray& ConnectionState::getMacKey() const {
 
     return entity == server ? clientWriteMACKey : serverWriteMACKey;
@@ -184,6 +278,12 @@ MACAlgorithm ConnectionState::getHMAC() const {
 
 }
 
+KeyExchangeAlgorithm ConnectionState::getKeyExchangeAlgorithm() const {
+
+    return keyExchange;
+
+}
+
 uint32_t ConnectionState::getMacKeyLength() const {
 
     return macKeyLength;
@@ -241,6 +341,12 @@ int64_t ConnectionState::getSequenceNumber() const {
 
 }
 
+PRFAlgorithm ConnectionState::getPRF() const {
+
+    return prf;
+
+}
+
 const coder::ByteArray& ConnectionState::getServerRandom() const {
 
     return serverRandom;
@@ -256,6 +362,21 @@ void ConnectionState::incrementSequence() {
 
 }
 
+/*
+ * Generate the write keys for an abbreviated handshake. The client
+ * and server randoms must be set first.
+ */
+void ConnectionState::resumeKeys(const coder::ByteArray& master) {
+
+    if (master.getLength() != 48) {
+        throw BadParameterException("Invalid master secret");
+    }
+
+    masterSecret = master;
+    generateKeyBlock();
+
+}
+
 #ifdef _TLS_THREAD_LOCAL_
 /*
  * promote the pending read state. Throws StateException if
@@ -273,7 +394,9 @@ void ConnectionState::promoteRead() {
 
     LocalConnectionState *lcs = dynamic_cast<LocalConnectionState*>(currentRead);
     delete lcs->getLocal();
-    lcs->setLocal(new ConnectionState(*getPendingRead()));
+    ConnectionState *cr = new ConnectionState(*getPendingRead());
+    cr->createAEADCipher();
+    lcs->setLocal(cr);
     getPendingRead()->initialized = false;
 
 }
@@ -294,7 +417,9 @@ void ConnectionState::promoteWrite() {
 
     LocalConnectionState *lcs = dynamic_cast<LocalConnectionState*>(currentWrite);
     delete lcs->getLocal();
-    lcs->setLocal(new ConnectionState(*getPendingWrite()));
+    ConnectionState *cw = new ConnectionState(*getPendingWrite());
+    cw->createAEADCipher();
+    lcs->setLocal(cw);
     getPendingWrite()->initialized = false;
 
 }
@@ -311,6 +436,9 @@ void ConnectionState::promoteRead(StateContainer *holder) {
 
     delete holder->currentRead;
     holder->currentRead = holder->pendingRead;
+    if (holder->currentRead->aeadCipher == 0) {
+        holder->currentRead->createAEADCipher();
+    }
     holder->pendingRead = new ConnectionState(*holder->currentRead);
     holder->pendingRead->initialized = false;
 
@@ -328,6 +456,9 @@ void ConnectionState::promoteWrite(StateContainer *holder) {
 
     delete holder->currentWrite;
     holder->currentWrite = holder->pendingWrite;
+    if (holder->currentWrite->aeadCipher == 0) {
+        holder->currentWrite->createAEADCipher();
+    }
     holder->pendingWrite = new ConnectionState(*holder->currentWrite);
     holder->pendingWrite->initialized = false;
 
@@ -369,8 +500,10 @@ void ConnectionState::setCipherType(CipherType type) {
             // CBC mode. IV length = cipher block lenght
             break;
         case aead:
-            // GCM mode. IV length = 12 for performance reasons.
-            fixedIVLength = 12;
+            // GCM mode. A 4 byte salt from the key block and an 8 byte
+            // explicit nonce in each record. See RFC 5288 Section 3.
+            fixedIVLength = 4;
+            recordIVLength = 8;
             break;
         default:
             throw StateException("Invalid HMAC algorithm");
@@ -378,6 +511,72 @@ void ConnectionState::setCipherType(CipherType type) {
 
 }
 
+/*
+ * Sets the cipher suite and the key exchange, cipher, key length, MAC
+ * and PRF it calls for.
+ */
+void ConnectionState::setCipherSuite(CipherSuite cs) {
+
+    switch (cs) {
+        case TLS_DHE_RSA_WITH_AES_256_GCM_SHA384:
+        case TLS_DHE_RSA_WITH_AES_128_GCM_SHA256:
+            keyExchange = dhe_rsa;
+            break;
+        case TLS_ECDHE_ECDSA_WITH_AES_256_GCM_SHA384:
+        case TLS_ECDHE_RSA_WITH_AES_256_GCM_SHA384:
+        case TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256:
+        case TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256:
+            keyExchange = ec_diffie_hellman;
+            break;
+        case TLS_RSA_WITH_AES_256_CBC_SHA256:
+        case TLS_RSA_WITH_AES_128_CBC_SHA256:
+            keyExchange = rsa_ke;
+            break;
+        default:
+            throw StateException("Unsupported cipher suite");
+    }
+
+    switch (cs) {
+        case TLS_DHE_RSA_WITH_AES_256_GCM_SHA384:
+        case TLS_ECDHE_ECDSA_WITH_AES_256_GCM_SHA384:
+        case TLS_ECDHE_RSA_WITH_AES_256_GCM_SHA384:
+            setCipherType(aead);
+            setCipherAlgorithm(aes);
+            setEncryptionKeyLength(256);
+            setHMAC(hmac_sha384);
+            prf = tls_prf_sha384;
+            break;
+        case TLS_DHE_RSA_WITH_AES_128_GCM_SHA256:
+        case TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256:
+        case TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256:
+            setCipherType(aead);
+            setCipherAlgorithm(aes);
+            setEncryptionKeyLength(128);
+            setHMAC(hmac_sha256);
+            prf = tls_prf_sha256;
+            break;
+        case TLS_RSA_WITH_AES_256_CBC_SHA256:
+            setCipherType(block);
+            setCipherAlgorithm(aes);
+            setEncryptionKeyLength(256);
+            setHMAC(hmac_sha256);
+            prf = tls_prf_sha256;
+            break;
+        case TLS_RSA_WITH_AES_128_CBC_SHA256:
+            setCipherType(block);
+            setCipherAlgorithm(aes);
+            setEncryptionKeyLength(128);
+            setHMAC(hmac_sha256);
+            prf = tls_prf_sha256;
+            break;
+        default:
+            throw StateException("Unsupported cipher suite");
+    }
+
+    suite = cs;
+
+}
+
 void ConnectionState::setClientRandom(const coder::ByteArray& rnd) {
 
     clientRandom = rnd;
@@ -429,6 +628,12 @@ void ConnectionState::setHMAC(MACAlgorithm m) {
 
 }
 
+void ConnectionState::setPRF(PRFAlgorithm alg) {
+
+    prf = alg;
+
+}
+
 void ConnectionState::setInitialized() {
 
     initialized = true;
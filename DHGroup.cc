@@ -0,0 +1,181 @@
+#include "tls/DHGroup.h"
+#include <coder/Unsigned16.h>
+
+namespace CKTLS {
+
+// RFC 7919 Appendix A.1.
+static const uint8_t FFDHE2048[] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xad, 0xf8, 0x54, 0x58,
+    0xa2, 0xbb, 0x4a, 0x9a, 0xaf, 0xdc, 0x56, 0x20, 0x27, 0x3d, 0x3c, 0xf1,
+    0xd8, 0xb9, 0xc5, 0x83, 0xce, 0x2d, 0x36, 0x95, 0xa9, 0xe1, 0x36, 0x41,
+    0x14, 0x64, 0x33, 0xfb, 0xcc, 0x93, 0x9d, 0xce, 0x24, 0x9b, 0x3e, 0xf9,
+    0x7d, 0x2f, 0xe3, 0x63, 0x63, 0x0c, 0x75, 0xd8, 0xf6, 0x81, 0xb2, 0x02,
+    0xae, 0xc4, 0x61, 0x7a, 0xd3, 0xdf, 0x1e, 0xd5, 0xd5, 0xfd, 0x65, 0x61,
+    0x24, 0x33, 0xf5, 0x1f, 0x5f, 0x06, 0x6e, 0xd0, 0x85, 0x63, 0x65, 0x55,
+    0x3d, 0xed, 0x1a, 0xf3, 0xb5, 0x57, 0x13, 0x5e, 0x7f, 0x57, 0xc9, 0x35,
+    0x98, 0x4f, 0x0c, 0x70, 0xe0, 0xe6, 0x8b, 0x77, 0xe2, 0xa6, 0x89, 0xda,
+    0xf3, 0xef, 0xe8, 0x72, 0x1d, 0xf1, 0x58, 0xa1, 0x36, 0xad, 0xe7, 0x35,
+    0x30, 0xac, 0xca, 0x4f, 0x48, 0x3a, 0x79, 0x7a, 0xbc, 0x0a, 0xb1, 0x82,
+    0xb3, 0x24, 0xfb, 0x61, 0xd1, 0x08, 0xa9, 0x4b, 0xb2, 0xc8, 0xe3, 0xfb,
+    0xb9, 0x6a, 0xda, 0xb7, 0x60, 0xd7, 0xf4, 0x68, 0x1d, 0x4f, 0x42, 0xa3,
+    0xde, 0x39, 0x4d, 0xf4, 0xae, 0x56, 0xed, 0xe7, 0x63, 0x72, 0xbb, 0x19,
+    0x0b, 0x07, 0xa7, 0xc8, 0xee, 0x0a, 0x6d, 0x70, 0x9e, 0x02, 0xfc, 0xe1,
+    0xcd, 0xf7, 0xe2, 0xec, 0xc0, 0x34, 0x04, 0xcd, 0x28, 0x34, 0x2f, 0x61,
+    0x91, 0x72, 0xfe, 0x9c, 0xe9, 0x85, 0x83, 0xff, 0x8e, 0x4f, 0x12, 0x32,
+    0xee, 0xf2, 0x81, 0x83, 0xc3, 0xfe, 0x3b, 0x1b, 0x4c, 0x6f, 0xad, 0x73,
+    0x3b, 0xb5, 0xfc, 0xbc, 0x2e, 0xc2, 0x20, 0x05, 0xc5, 0x8e, 0xf1, 0x83,
+    0x7d, 0x16, 0x83, 0xb2, 0xc6, 0xf3, 0x4a, 0x26, 0xc1, 0xb2, 0xef, 0xfa,
+    0x88, 0x6b, 0x42, 0x38, 0x61, 0x28, 0x5c, 0x97, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff
+};
+
+// RFC 7919 Appendix A.2.
+static const uint8_t FFDHE3072[] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xad, 0xf8, 0x54, 0x58,
+    0xa2, 0xbb, 0x4a, 0x9a, 0xaf, 0xdc, 0x56, 0x20, 0x27, 0x3d, 0x3c, 0xf1,
+    0xd8, 0xb9, 0xc5, 0x83, 0xce, 0x2d, 0x36, 0x95, 0xa9, 0xe1, 0x36, 0x41,
+    0x14, 0x64, 0x33, 0xfb, 0xcc, 0x93, 0x9d, 0xce, 0x24, 0x9b, 0x3e, 0xf9,
+    0x7d, 0x2f, 0xe3, 0x63, 0x63, 0x0c, 0x75, 0xd8, 0xf6, 0x81, 0xb2, 0x02,
+    0xae, 0xc4, 0x61, 0x7a, 0xd3, 0xdf, 0x1e, 0xd5, 0xd5, 0xfd, 0x65, 0x61,
+    0x24, 0x33, 0xf5, 0x1f, 0x5f, 0x06, 0x6e, 0xd0, 0x85, 0x63, 0x65, 0x55,
+    0x3d, 0xed, 0x1a, 0xf3, 0xb5, 0x57, 0x13, 0x5e, 0x7f, 0x57, 0xc9, 0x35,
+    0x98, 0x4f, 0x0c, 0x70, 0xe0, 0xe6, 0x8b, 0x77, 0xe2, 0xa6, 0x89, 0xda,
+    0xf3, 0xef, 0xe8, 0x72, 0x1d, 0xf1, 0x58, 0xa1, 0x36, 0xad, 0xe7, 0x35,
+    0x30, 0xac, 0xca, 0x4f, 0x48, 0x3a, 0x79, 0x7a, 0xbc, 0x0a, 0xb1, 0x82,
+    0xb3, 0x24, 0xfb, 0x61, 0xd1, 0x08, 0xa9, 0x4b, 0xb2, 0xc8, 0xe3, 0xfb,
+    0xb9, 0x6a, 0xda, 0xb7, 0x60, 0xd7, 0xf4, 0x68, 0x1d, 0x4f, 0x42, 0xa3,
+    0xde, 0x39, 0x4d, 0xf4, 0xae, 0x56, 0xed, 0xe7, 0x63, 0x72, 0xbb, 0x19,
+    0x0b, 0x07, 0xa7, 0xc8, 0xee, 0x0a, 0x6d, 0x70, 0x9e, 0x02, 0xfc, 0xe1,
+    0xcd, 0xf7, 0xe2, 0xec, 0xc0, 0x34, 0x04, 0xcd, 0x28, 0x34, 0x2f, 0x61,
+    0x91, 0x72, 0xfe, 0x9c, 0xe9, 0x85, 0x83, 0xff, 0x8e, 0x4f, 0x12, 0x32,
+    0xee, 0xf2, 0x81, 0x83, 0xc3, 0xfe, 0x3b, 0x1b, 0x4c, 0x6f, 0xad, 0x73,
+    0x3b, 0xb5, 0xfc, 0xbc, 0x2e, 0xc2, 0x20, 0x05, 0xc5, 0x8e, 0xf1, 0x83,
+    0x7d, 0x16, 0x83, 0xb2, 0xc6, 0xf3, 0x4a, 0x26, 0xc1, 0xb2, 0xef, 0xfa,
+    0x88, 0x6b, 0x42, 0x38, 0x61, 0x1f, 0xcf, 0xdc, 0xde, 0x35, 0x5b, 0x3b,
+    0x65, 0x19, 0x03, 0x5b, 0xbc, 0x34, 0xf4, 0xde, 0xf9, 0x9c, 0x02, 0x38,
+    0x61, 0xb4, 0x6f, 0xc9, 0xd6, 0xe6, 0xc9, 0x07, 0x7a, 0xd9, 0x1d, 0x26,
+    0x91, 0xf7, 0xf7, 0xee, 0x59, 0x8c, 0xb0, 0xfa, 0xc1, 0x86, 0xd9, 0x1c,
+    0xae, 0xfe, 0x13, 0x09, 0x85, 0x13, 0x92, 0x70, 0xb4, 0x13, 0x0c, 0x93,
+    0xbc, 0x43, 0x79, 0x44, 0xf4, 0xfd, 0x44, 0x52, 0xe2, 0xd7, 0x4d, 0xd3,
+    0x64, 0xf2, 0xe2, 0x1e, 0x71, 0xf5, 0x4b, 0xff, 0x5c, 0xae, 0x82, 0xab,
+    0x9c, 0x9d, 0xf6, 0x9e, 0xe8, 0x6d, 0x2b, 0xc5, 0x22, 0x36, 0x3a, 0x0d,
+    0xab, 0xc5, 0x21, 0x97, 0x9b, 0x0d, 0xea, 0xda, 0x1d, 0xbf, 0x9a, 0x42,
+    0xd5, 0xc4, 0x48, 0x4e, 0x0a, 0xbc, 0xd0, 0x6b, 0xfa, 0x53, 0xdd, 0xef,
+    0x3c, 0x1b, 0x20, 0xee, 0x3f, 0xd5, 0x9d, 0x7c, 0x25, 0xe4, 0x1d, 0x2b,
+    0x66, 0xc6, 0x2e, 0x37, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+};
+
+/*
+ * The encoded parameters are the dh_p and dh_g fields of
+ * ServerDHParams. See RFC 5246 Section 7.4.3.
+ */
+DHGroup::DHGroup(const uint8_t *pBytes, unsigned length, unsigned bits)
+: g(2),
+  prime(pBytes, length),
+  exponentBits(bits) {
+
+    p.decode(prime, CK::BigInteger::BIGENDIAN);
+
+    coder::Unsigned16 len(length);
+    params.append(len.getEncoded(coder::bigendian));
+    params.append(prime);
+    coder::ByteArray gBytes(g.getEncoded(CK::BigInteger::BIGENDIAN));
+    len.setValue(gBytes.getLength());
+    params.append(len.getEncoded(coder::bigendian));
+    params.append(gBytes);
+
+}
+
+DHGroup::~DHGroup() {
+}
+
+/*
+ * Private exponent sizes are from RFC 7919 Section 5.2, rounded up.
+ */
+const DHGroup& DHGroup::ffdhe2048() {
+
+    static const DHGroup group(FFDHE2048, sizeof(FFDHE2048), 256);
+    return group;
+
+}
+
+const DHGroup& DHGroup::ffdhe3072() {
+
+    static const DHGroup group(FFDHE3072, sizeof(FFDHE3072), 320);
+    return group;
+
+}
+
+/*
+ * Only the RFC 7919 groups are accepted from a server, so a peer can't
+ * choose a small or weak group.
+ */
+const DHGroup *DHGroup::find(const CK::BigInteger& p, const CK::BigInteger& g) {
+
+    coder::ByteArray pBytes(p.getEncoded(CK::BigInteger::BIGENDIAN));
+    coder::ByteArray gBytes(g.getEncoded(CK::BigInteger::BIGENDIAN));
+    const DHGroup *groups[] = { &ffdhe2048(), &ffdhe3072() };
+    for (unsigned i = 0; i < sizeof(groups) / sizeof(groups[0]); ++i) {
+        if (pBytes == groups[i]->p.getEncoded(CK::BigInteger::BIGENDIAN)
+                && gBytes == groups[i]->g.getEncoded(CK::BigInteger::BIGENDIAN)) {
+            return groups[i];
+        }
+    }
+    return 0;
+
+}
+
+const coder::ByteArray& DHGroup::getEncodedParams() const {
+
+    return params;
+
+}
+
+unsigned DHGroup::getExponentBits() const {
+
+    return exponentBits;
+
+}
+
+const CK::BigInteger& DHGroup::getGenerator() const {
+
+    return g;
+
+}
+
+const CK::BigInteger& DHGroup::getModulus() const {
+
+    return p;
+
+}
+
+/*
+ * Public value check from RFC 7919 Section 5.1. The values 1 and p-1
+ * would make the shared secret predictable. The groups' primes are odd,
+ * so p-1 differs from p only in its last byte.
+ */
+bool DHGroup::validPublicKey(const CK::BigInteger& y) const {
+
+    coder::ByteArray yBytes(y.getEncoded(CK::BigInteger::BIGENDIAN));
+    unsigned start = 0;
+    while (start < yBytes.getLength() && yBytes[start] == 0) {
+        start++;
+    }
+    unsigned length = yBytes.getLength() - start;
+    if (length == 0 || (length == 1 && yBytes[start] < 2)) {
+        return false;
+    }
+    if (length != prime.getLength()) {
+        return length < prime.getLength();
+    }
+    for (unsigned i = 0; i < length; ++i) {
+        uint8_t limit = i == length - 1 ? prime[i] - 1 : prime[i];
+        if (yBytes[start + i] != limit) {
+            return yBytes[start + i] < limit;
+        }
+    }
+    return false;
+
+}
+
+}
@@ -0,0 +1,93 @@
+#include "tls/DHKeyPool.h"
+#include "tls/DHGroup.h"
+#include "tls/exceptions/BadParameterException.h"
+#include <CryptoKitty-C/random/FortunaSecureRandom.h>
+
+namespace CKTLS {
+
+// Static initialization.
+const unsigned DHKeyPool::DEFAULT_DEPTH = 256;
+const unsigned DHKeyPool::DEFAULT_THREADS = 1;
+
+DHKeyPool::DHKeyPool(const DHGroup& g, unsigned d, unsigned threads)
+: group(g),
+  depth(d),
+  pending(0),
+  misses(0) {
+
+    if (depth == 0) {
+        throw BadParameterException("Invalid key pool depth");
+    }
+
+    start(threads);
+
+}
+
+DHKeyPool::~DHKeyPool() {
+
+    stop();
+
+}
+
+void DHKeyPool::abandon(unsigned /* index */) {
+
+    pending--;
+
+}
+
+bool DHKeyPool::claim(unsigned& index) {
+
+    if (keys.size() + pending >= depth) {
+        return false;
+    }
+
+    pending++;
+    index = 0;
+    return true;
+
+}
+
+DHKey DHKeyPool::generate() const {
+
+    CK::FortunaSecureRandom rnd;
+    DHKey key;
+    key.secret = CK::BigInteger(group.getExponentBits(), rnd);
+    key.publicKey = group.getGenerator().modPow(key.secret, group.getModulus());
+    return key;
+
+}
+
+uint64_t DHKeyPool::getMisses() const {
+
+    return misses.load(std::memory_order_relaxed);
+
+}
+
+DHKey DHKeyPool::pop() {
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (keys.size() > 0) {
+            DHKey key(keys.front());
+            keys.pop_front();
+            wanted.notify_one();
+            return key;
+        }
+    }
+
+    misses.fetch_add(1, std::memory_order_relaxed);
+    wanted.notify_one();
+    return generate();
+
+}
+
+void DHKeyPool::produce(unsigned /* index */) {
+
+    DHKey key(generate());
+    std::lock_guard<std::mutex> guard(lock);
+    pending--;
+    keys.push_back(key);
+
+}
+
+}
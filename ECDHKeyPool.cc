@@ -0,0 +1,143 @@
+#include "tls/ECDHKeyPool.h"
+#include "tls/exceptions/BadParameterException.h"
+#include <CryptoKitty-C/keys/ECDHKeyExchange.h>
+
+namespace CKTLS {
+
+// Static initialization.
+const unsigned ECDHKeyPool::DEFAULT_DEPTH = 256;
+const unsigned ECDHKeyPool::DEFAULT_THREADS = 1;
+
+ECDHKeyPool::ECDHKeyPool(unsigned d, unsigned threads)
+: depth(d),
+  misses(0) {
+
+    if (depth == 0) {
+        throw BadParameterException("Invalid key pool depth");
+    }
+
+    pools[0].curve = secp256r1;
+    pools[0].pending = 0;
+    pools[1].curve = secp384r1;
+    pools[1].pending = 0;
+
+    start(threads);
+
+}
+
+ECDHKeyPool::~ECDHKeyPool() {
+
+    stop();
+
+    for (unsigned c = 0; c < CURVE_COUNT; ++c) {
+        while (pools[c].keys.size() > 0) {
+            delete pools[c].keys.front().exchange;
+            pools[c].keys.pop_front();
+        }
+    }
+
+}
+
+void ECDHKeyPool::abandon(unsigned index) {
+
+    pools[index].pending--;
+
+}
+
+/*
+ * Choose the curve with the fewest key pairs ready or pending.
+ */
+bool ECDHKeyPool::claim(unsigned& index) {
+
+    CurvePool *neediest = 0;
+    for (unsigned c = 0; c < CURVE_COUNT; ++c) {
+        unsigned count = pools[c].keys.size() + pools[c].pending;
+        if (count < depth && (neediest == 0
+                || count < neediest->keys.size() + neediest->pending)) {
+            neediest = pools + c;
+        }
+    }
+    if (neediest == 0) {
+        return false;
+    }
+
+    neediest->pending++;
+    index = neediest - pools;
+    return true;
+
+}
+
+/*
+ * Generate a key pair. The public key is computed here, so the
+ * exchange only has the shared secret left to compute.
+ */
+ECDHKey ECDHKeyPool::generate(NamedCurve curve) {
+
+    ECDHKey key;
+    switch (curve) {
+        case secp256r1:
+            key.exchange = new CK::ECDHKeyExchange(CK::ECDHKeyExchange::SECP256R1);
+            break;
+        case secp384r1:
+            key.exchange = new CK::ECDHKeyExchange(CK::ECDHKeyExchange::SECP384R1);
+            break;
+        default:
+            throw BadParameterException("Unsupported named curve");
+    }
+    try {
+        key.publicKey = key.exchange->getPublicKey();
+    }
+    catch (...) {
+        delete key.exchange;
+        throw;
+    }
+    return key;
+
+}
+
+uint64_t ECDHKeyPool::getMisses() const {
+
+    return misses.load(std::memory_order_relaxed);
+
+}
+
+ECDHKeyPool::CurvePool& ECDHKeyPool::getPool(NamedCurve curve) {
+
+    for (unsigned c = 0; c < CURVE_COUNT; ++c) {
+        if (pools[c].curve == curve) {
+            return pools[c];
+        }
+    }
+    throw BadParameterException("Unsupported named curve");
+
+}
+
+ECDHKey ECDHKeyPool::pop(NamedCurve curve) {
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        CurvePool& pool(getPool(curve));
+        if (pool.keys.size() > 0) {
+            ECDHKey key(pool.keys.front());
+            pool.keys.pop_front();
+            wanted.notify_one();
+            return key;
+        }
+    }
+
+    misses.fetch_add(1, std::memory_order_relaxed);
+    wanted.notify_one();
+    return generate(curve);
+
+}
+
+void ECDHKeyPool::produce(unsigned index) {
+
+    ECDHKey key(generate(pools[index].curve));
+    std::lock_guard<std::mutex> guard(lock);
+    pools[index].pending--;
+    pools[index].keys.push_back(key);
+
+}
+
+}
@@ -7,6 +7,7 @@ namespace CKTLS {
 const uint16_t ExtensionManager::CERT_TYPE = 0x0009;
 const uint16_t ExtensionManager::SUPPORTED_CURVES = 0x000a;
 const uint16_t ExtensionManager::POINT_FORMATS = 0x000b;
+const uint16_t ExtensionManager::SESSION_TICKET = 0x0023;
 const Extension ExtensionManager::dummy = { coder::Unsigned16(0xffff), coder::ByteArray(0) };
 
 ExtensionManager::ExtensionManager() {
@@ -23,9 +23,9 @@ Finished::~Finished() {
 bool Finished::authenticate(const coder::ByteArray& fin) const {
 
 #ifdef _TLS_THREAD_LOCAL_
-    ConnectionState *state = ConnectionState::getCurrentRead();
+    ConnectionState *state = ConnectionState::getCurrentWrite();
 #else
-    ConnectionState *state = holder->getCurrentRead();
+    ConnectionState *state = holder->getCurrentWrite();
 #endif
     MACAlgorithm mac = state->getHMAC();
     CK::Digest *digest;
@@ -49,8 +49,9 @@ bool Finished::authenticate(const coder::ByteArray& fin) const {
             throw RecordException("Invalid HMAC algorithm");
     }
 
+    // Authenticating the peer's message, so use the peer's label.
     ConnectionEnd end = state->getEntity();
-    coder::ByteArray seed(end == server ? "server finished" : "client finished");
+    coder::ByteArray seed(end == server ? "client finished" : "server finished");
     coder::ByteArray hash(digest->digest(fin));
     seed.append(hash);
 
@@ -76,9 +77,9 @@ const coder::ByteArray& Finished::encode() {
     encoded.clear();
 
 #ifdef _TLS_THREAD_LOCAL_
-    ConnectionState *state = ConnectionState::getCurrentWrite();
+    ConnectionState *state = ConnectionState::getCurrentRead();
 #else
-    ConnectionState *state = holder->getCurrentWrite();
+    ConnectionState *state = holder->getCurrentRead();
 #endif
     MACAlgorithm mac = state->getHMAC();
     CK::Digest *digest;
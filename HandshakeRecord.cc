@@ -7,6 +7,7 @@
 #include "tls/ServerKeyExchange.h"
 #include "tls/ClientKeyExchange.h"
 #include "tls/Finished.h"
+#include "tls/NewSessionTicket.h"
 #include "tls/ConnectionState.h"
 #include "coder/Unsigned32.h"
 #include "tls/exceptions/RecordException.h"
@@ -72,6 +73,12 @@ HandshakeRecord::HandshakeRecord(HandshakeType h, StateContainer *hold)
             }
             body = new ServerHello;
             break;
+        case new_session_ticket:
+            if (end != server) {
+                throw RecordException("Wrong connection state");
+            }
+            body = new NewSessionTicket;
+            break;
         case server_hello_done:
             if (end != server) {
                 throw RecordException("Wrong connection state");
@@ -92,7 +99,11 @@ HandshakeRecord::HandshakeRecord(HandshakeType h, StateContainer *hold)
             if (end != client) {
                 throw RecordException("Wrong connection state");
             }
+#ifdef _TLS_THREAD_LOCAL_
             body = new ClientKeyExchange;
+#else
+            body = new ClientKeyExchange(holder);
+#endif
             break;
         case finished:
 #ifdef _TLS_THREAD_LOCAL_
@@ -142,6 +153,9 @@ void HandshakeRecord::decode() {
         case server_hello:
             body = new ServerHello;
             break;
+        case new_session_ticket:
+            body = new NewSessionTicket;
+            break;
         case server_hello_done:
             body = new ServerHelloDone;
             break;
@@ -153,7 +167,11 @@ void HandshakeRecord::decode() {
 #endif
             break;
         case client_key_exchange:
+#ifdef _TLS_THREAD_LOCAL_
             body = new ClientKeyExchange;
+#else
+            body = new ClientKeyExchange(holder);
+#endif
             break;
         case finished:
 #ifdef _TLS_THREAD_LOCAL_
@@ -174,7 +192,7 @@ void HandshakeRecord::encode() {
 
     fragment.clear();
     fragment.append(type);
-    coder::ByteArray encoded(body->encode());
+    const coder::ByteArray& encoded(body->encode());
     coder::Unsigned32 bodyLen(encoded.getLength());
     coder::ByteArray bl(bodyLen.getEncoded(coder::bigendian));
     fragment.append(bl.range(1, 3));    // 24 bit length.
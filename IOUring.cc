@@ -0,0 +1,197 @@
+#include "tls/IOUring.h"
+#include "tls/exceptions/RecordException.h"
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace CKTLS {
+
+IOUring::IOUring(unsigned e)
+: fd(-1),
+  sqRing(MAP_FAILED),
+  sqes(static_cast<io_uring_sqe*>(MAP_FAILED)),
+  sqeTail(0),
+  cqRing(MAP_FAILED) {
+
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    fd = ::syscall(__NR_io_uring_setup, e, &params);
+    if (fd < 0) {
+        throw RecordException(std::string("io_uring setup failed: ")
+                                                    + std::strerror(errno));
+    }
+    entries = params.sq_entries;
+
+    sqRingLength = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingLength = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+        if (cqRingLength > sqRingLength) {
+            sqRingLength = cqRingLength;
+        }
+        cqRingLength = sqRingLength;
+    }
+    sqRing = ::mmap(0, sqRingLength, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sqRing != MAP_FAILED) {
+        if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+            cqRing = sqRing;
+        }
+        else {
+            cqRing = ::mmap(0, cqRingLength, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        }
+    }
+    sqesLength = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe*>(::mmap(0, sqesLength, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+    if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED) {
+        int error = errno;
+        unmap();
+        throw RecordException(std::string("io_uring map failed: ")
+                                                    + std::strerror(error));
+    }
+
+    uint8_t *sq = static_cast<uint8_t*>(sqRing);
+    sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    // Entries are always submitted in order, so the index array is fixed.
+    unsigned *array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    for (unsigned i = 0; i < entries; ++i) {
+        array[i] = i;
+    }
+    sqeTail = *sqTail;
+
+    uint8_t *cq = static_cast<uint8_t*>(cqRing);
+    cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    probe();
+
+}
+
+IOUring::~IOUring() {
+
+    unmap();
+
+}
+
+io_uring_sqe *IOUring::getSQE() {
+
+    if (sqeTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= entries) {
+        submit();
+        if (sqeTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= entries) {
+            return 0;
+        }
+    }
+    io_uring_sqe *sqe = &sqes[sqeTail & sqMask];
+    sqeTail++;
+    std::memset(sqe, 0, sizeof(io_uring_sqe));
+    return sqe;
+
+}
+
+io_uring_cqe *IOUring::peekCQE() {
+
+    unsigned head = *cqHead;
+    if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    return &cqes[head & cqMask];
+
+}
+
+/*
+ * Kernels before 5.6 can't be probed. They are taken to support none
+ * of the operations, since several we need arrived in 5.6.
+ */
+void IOUring::probe() {
+
+    const unsigned count = 256;
+    std::vector<uint8_t> space(sizeof(io_uring_probe)
+                                    + count * sizeof(io_uring_probe_op));
+    io_uring_probe *result = reinterpret_cast<io_uring_probe*>(&space[0]);
+    opcodes.assign(count, false);
+    if (::syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE,
+                                                    result, count) < 0) {
+        return;
+    }
+    for (unsigned i = 0; i < result->ops_len && i < count; ++i) {
+        if ((result->ops[i].flags & IO_URING_OP_SUPPORTED) != 0) {
+            opcodes[result->ops[i].op] = true;
+        }
+    }
+
+}
+
+void IOUring::registerBuffer(void *base, size_t length) {
+
+    iovec iov;
+    iov.iov_base = base;
+    iov.iov_len = length;
+    if (::syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, &iov, 1) < 0) {
+        throw RecordException(std::string("io_uring buffer registration failed: ")
+                                                    + std::strerror(errno));
+    }
+
+}
+
+void IOUring::seen() {
+
+    __atomic_store_n(cqHead, *cqHead + 1, __ATOMIC_RELEASE);
+
+}
+
+/*
+ * Entries the kernel hasn't consumed yet, for instance after an
+ * interrupted wait, are submitted again by the next call.
+ */
+void IOUring::submit(unsigned wait) {
+
+    __atomic_store_n(sqTail, sqeTail, __ATOMIC_RELEASE);
+    unsigned count = sqeTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    if (count == 0 && wait == 0) {
+        return;
+    }
+    int result = ::syscall(__NR_io_uring_enter, fd, count, wait,
+                                wait > 0 ? IORING_ENTER_GETEVENTS : 0, 0, 0);
+    if (result < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        throw RecordException(std::string("io_uring enter failed: ")
+                                                    + std::strerror(errno));
+    }
+
+}
+
+bool IOUring::supports(unsigned opcode) const {
+
+    return opcode < opcodes.size() && opcodes[opcode];
+
+}
+
+void IOUring::unmap() {
+
+    if (sqes != MAP_FAILED) {
+        ::munmap(sqes, sqesLength);
+    }
+    if (cqRing != MAP_FAILED && cqRing != sqRing) {
+        ::munmap(cqRing, cqRingLength);
+    }
+    if (sqRing != MAP_FAILED) {
+        ::munmap(sqRing, sqRingLength);
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    cqRing = sqRing = MAP_FAILED;
+    fd = -1;
+
+}
+
+}
@@ -0,0 +1,141 @@
+#include "tls/KernelTLS.h"
+#include "tls/ConnectionState.h"
+#include "tls/exceptions/RecordException.h"
+#include <cstring>
+#include <cerrno>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <linux/tls.h>
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+
+namespace CKTLS {
+
+// Static initialization.
+const unsigned KernelTLS::SALT_LENGTH = TLS_CIPHER_AES_GCM_128_SALT_SIZE;
+
+static void copyBytes(unsigned char *dest, const coder::ByteArray& src) {
+
+    for (unsigned i = 0; i < src.getLength(); ++i) {
+        dest[i] = src[i];
+    }
+
+}
+
+/*
+ * The explicit nonce starts at the sequence number, as most
+ * implementations do. The kernel increments both after every record.
+ */
+bool KernelTLS::enable(int fd, const ConnectionState& state,
+                                                    Direction direction) {
+
+    if (!supported(state)) {
+        return false;
+    }
+
+    const coder::ByteArray& key(direction == transmit ?
+                                state.getLocalKey() : state.getEncryptionKey());
+    const coder::ByteArray& salt(direction == transmit ?
+                                state.getLocalIV() : state.getIV());
+    unsigned char sequence[8];
+    uint64_t number = state.getSequenceNumber();
+    for (int i = 7; i >= 0; --i) {
+        sequence[i] = number & 0xff;
+        number = number >> 8;
+    }
+
+    union {
+        tls12_crypto_info_aes_gcm_128 gcm128;
+        tls12_crypto_info_aes_gcm_256 gcm256;
+    } info;
+    std::memset(&info, 0, sizeof(info));
+    socklen_t length;
+    if (key.getLength() == TLS_CIPHER_AES_GCM_128_KEY_SIZE) {
+        info.gcm128.info.version = TLS_1_2_VERSION;
+        info.gcm128.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+        copyBytes(info.gcm128.key, key);
+        copyBytes(info.gcm128.salt, salt);
+        std::memcpy(info.gcm128.iv, sequence, sizeof(sequence));
+        std::memcpy(info.gcm128.rec_seq, sequence, sizeof(sequence));
+        length = sizeof(info.gcm128);
+    }
+    else {
+        info.gcm256.info.version = TLS_1_2_VERSION;
+        info.gcm256.info.cipher_type = TLS_CIPHER_AES_GCM_256;
+        copyBytes(info.gcm256.key, key);
+        copyBytes(info.gcm256.salt, salt);
+        std::memcpy(info.gcm256.iv, sequence, sizeof(sequence));
+        std::memcpy(info.gcm256.rec_seq, sequence, sizeof(sequence));
+        length = sizeof(info.gcm256);
+    }
+
+    // ENOENT when the tls module isn't available. EEXIST when the
+    // other direction has already been enabled.
+    if (::setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) < 0
+                                                    && errno != EEXIST) {
+        return false;
+    }
+    int option = direction == transmit ? TLS_TX : TLS_RX;
+    bool enabled = ::setsockopt(fd, SOL_TLS, option, &info, length) == 0;
+    std::memset(&info, 0, sizeof(info));
+    return enabled;
+
+}
+
+/*
+ * Records that aren't application data need their type in a control
+ * message. Returns false if the socket would block.
+ */
+bool KernelTLS::sendAlert(int fd, AlertDescription description,
+                                                        AlertLevel level) {
+
+    unsigned char alert[2];
+    alert[0] = level;
+    alert[1] = description;
+    iovec iov;
+    iov.iov_base = alert;
+    iov.iov_len = sizeof(alert);
+
+    char control[CMSG_SPACE(sizeof(unsigned char))];
+    std::memset(control, 0, sizeof(control));
+    msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_TLS;
+    cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(unsigned char));
+    *CMSG_DATA(cmsg) = CKTLS::alert;
+
+    if (::sendmsg(fd, &msg, MSG_NOSIGNAL) < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return false;
+        }
+        throw RecordException(std::string("Alert write failed: ")
+                                            + std::strerror(errno));
+    }
+    return true;
+
+}
+
+bool KernelTLS::supported(const ConnectionState& state) {
+
+    if (state.getCipherType() != aead || state.getCipherAlgorithm() != aes) {
+        return false;
+    }
+    unsigned keyLength = state.getLocalKey().getLength();
+    if (keyLength != TLS_CIPHER_AES_GCM_128_KEY_SIZE
+                    && keyLength != TLS_CIPHER_AES_GCM_256_KEY_SIZE) {
+        return false;
+    }
+    return state.getLocalIV().getLength() == SALT_LENGTH;
+
+}
+
+}
@@ -0,0 +1,86 @@
+#include "tls/KeyPool.h"
+#include <chrono>
+
+namespace CKTLS {
+
+// Static initialization.
+const unsigned KeyPool::MIN_BACKOFF = 10;
+const unsigned KeyPool::MAX_BACKOFF = 5000;
+
+KeyPool::KeyPool()
+: stopping(false) {
+}
+
+KeyPool::~KeyPool() {
+
+    stop();
+
+}
+
+/*
+ * Refill thread. Sleeps while the pool is full. After a failed
+ * generation it waits before the next one, doubling the wait while
+ * failures continue.
+ */
+void KeyPool::refill() {
+
+    unsigned backoff = 0;
+    std::unique_lock<std::mutex> guard(lock);
+    while (!stopping) {
+        unsigned index;
+        if (!claim(index)) {
+            wanted.wait(guard);
+            continue;
+        }
+
+        guard.unlock();
+        bool produced = true;
+        try {
+            produce(index);
+        }
+        catch (...) {
+            produced = false;
+        }
+        guard.lock();
+
+        if (produced) {
+            backoff = 0;
+            continue;
+        }
+        abandon(index);
+        backoff = backoff == 0 ? MIN_BACKOFF : backoff * 2;
+        if (backoff > MAX_BACKOFF) {
+            backoff = MAX_BACKOFF;
+        }
+        wanted.wait_for(guard, std::chrono::milliseconds(backoff),
+                                            [this] { return stopping; });
+    }
+
+}
+
+void KeyPool::start(unsigned threads) {
+
+    for (unsigned i = 0; i < threads; ++i) {
+        workers.push_back(std::thread(&KeyPool::refill, this));
+    }
+
+}
+
+/*
+ * Stop and join the refill threads. Safe to call more than once.
+ */
+void KeyPool::stop() {
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wanted.notify_all();
+    for (unsigned i = 0; i < workers.size(); ++i) {
+        workers[i].join();
+    }
+    workers.clear();
+
+}
+
+}
@@ -0,0 +1,306 @@
+#include "tls/Keyring.h"
+#include "tls/PGPCertificate.h"
+#include "tls/exceptions/BadParameterException.h"
+#include "tls/exceptions/EncodingException.h"
+#include "openpgp/packet/Packet.h"
+#include <CryptoKitty-C/digest/SHA1.h>
+#include <coder/ByteArray.h>
+#include <coder/Unsigned32.h>
+#include <coder/Unsigned64.h>
+#include <cstring>
+#include <cerrno>
+#include <fstream>
+#include <iterator>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace CKTLS {
+
+// Index format: magic (8) | keyring size (8) | keyring modification
+// time in nanoseconds (8) | count (4), then for each certificate key
+// ID (8) | offset (4) | length (4). Big endian.
+static const char INDEX_MAGIC[] = "CKTLSKR2";
+static const unsigned INDEX_HEADER_LENGTH = 28;
+static const unsigned INDEX_ENTRY_LENGTH = 16;
+
+// Packet tag and header length. See RFC 4880 Section 4.2.
+static unsigned packetTag(const uint8_t *packet) {
+
+    if ((packet[0] & 0x40) != 0) {
+        return packet[0] & 0x3f;
+    }
+    return (packet[0] >> 2) & 0x0f;
+
+}
+
+static unsigned headerLength(const uint8_t *packet) {
+
+    if ((packet[0] & 0x40) != 0) {
+        return packet[1] < 192 ? 2 : packet[1] < 224 ? 3 : 6;
+    }
+    switch (packet[0] & 0x03) {
+        case 0:
+            return 2;
+        case 1:
+            return 3;
+        case 2:
+            return 5;
+        default:
+            return 1;
+    }
+
+}
+
+Keyring::Keyring(const std::string& path)
+: data(0),
+  length(0),
+  modified(0) {
+
+    map(path);
+    scan();
+
+}
+
+Keyring::Keyring(const std::string& path, const std::string& indexPath)
+: data(0),
+  length(0),
+  modified(0) {
+
+    map(path);
+    if (!readIndex(indexPath)) {
+        scan();
+    }
+
+}
+
+Keyring::~Keyring() {
+
+    if (data != 0) {
+        munmap(const_cast<uint8_t*>(data), length);
+    }
+
+}
+
+bool Keyring::contains(uint64_t keyID) const {
+
+    return entries.find(keyID) != entries.end();
+
+}
+
+/*
+ * The certificate is parsed the first time it is requested and kept
+ * for the life of the keyring. Its key ID is checked against the
+ * primary key packet then, so an index that slipped past the checks
+ * in readIndex() can't hand out the wrong certificate.
+ */
+Keyring::CertificatePtr Keyring::getCertificate(uint64_t keyID) {
+
+    EntryMap::iterator it = entries.find(keyID);
+    if (it == entries.end()) {
+        throw BadParameterException("Unknown key ID");
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    Entry& entry(it->second);
+    if (!entry.cert) {
+        unsigned keyLength = PGPCertificate::packetLength(data + entry.offset,
+                                                                entry.length);
+        if (getKeyID(data + entry.offset, keyLength) != keyID) {
+            throw EncodingException("Stale keyring index");
+        }
+        coder::ByteArray encoded;
+        encoded.append(data + entry.offset, entry.length);
+        entry.cert.reset(new PGPCertificate(encoded));
+    }
+    return entry.cert;
+
+}
+
+/*
+ * V4 key ID, the low 64 bits of the fingerprint. See RFC 4880
+ * Section 12.2.
+ */
+uint64_t Keyring::getKeyID(const uint8_t *packet, unsigned packetLength) {
+
+    unsigned header = headerLength(packet);
+    unsigned body = packetLength - header;
+    if (body == 0 || body > 0xffff || packet[header] != 4) {
+        throw EncodingException("Unsupported public key version");
+    }
+
+    coder::ByteArray fp(1, 0x99);
+    fp.append(body >> 8);
+    fp.append(body & 0xff);
+    fp.append(packet + header, body);
+    CK::SHA1 sha1;
+    coder::ByteArray fingerprint(sha1.digest(fp));
+    coder::Unsigned64 id(fingerprint.range(fingerprint.getLength() - 8, 8),
+                                                        coder::bigendian);
+    return id.getValue();
+
+}
+
+std::vector<uint64_t> Keyring::getKeyIDs() const {
+
+    std::vector<uint64_t> ids;
+    for (EntryMap::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+        ids.push_back(it->first);
+    }
+    return ids;
+
+}
+
+void Keyring::map(const std::string& path) {
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw EncodingException(std::string("Keyring open failed: ")
+                                                + std::strerror(errno));
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        int error = errno;
+        close(fd);
+        throw EncodingException(std::string("Keyring open failed: ")
+                                                + std::strerror(error));
+    }
+    if (st.st_size == 0 || st.st_size > 0xffffffff) {
+        close(fd);
+        throw EncodingException("Invalid keyring size");
+    }
+
+    length = st.st_size;
+#ifdef __APPLE__
+    modified = uint64_t(st.st_mtimespec.tv_sec) * 1000000000
+                                            + st.st_mtimespec.tv_nsec;
+#else
+    modified = uint64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    void *mapped = mmap(0, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    int error = errno;
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        throw EncodingException(std::string("Keyring map failed: ")
+                                                + std::strerror(error));
+    }
+    data = static_cast<const uint8_t*>(mapped);
+
+}
+
+/*
+ * Returns false if the index doesn't exist or doesn't match the keyring.
+ * The keyring's size and modification time must match the ones it had
+ * when the index was written.
+ */
+bool Keyring::readIndex(const std::string& indexPath) {
+
+    std::ifstream in(indexPath.c_str(), std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    std::vector<char> index((std::istreambuf_iterator<char>(in)),
+                                        std::istreambuf_iterator<char>());
+    if (index.size() < INDEX_HEADER_LENGTH
+                    || std::memcmp(&index[0], INDEX_MAGIC, 8) != 0) {
+        return false;
+    }
+
+    coder::ByteArray encoded;
+    encoded.append(reinterpret_cast<const uint8_t*>(&index[0]), index.size());
+    coder::Unsigned64 size(encoded.range(8, 8), coder::bigendian);
+    coder::Unsigned64 mtime(encoded.range(16, 8), coder::bigendian);
+    coder::Unsigned32 count(encoded.range(24, 4), coder::bigendian);
+    if (size.getValue() != length || mtime.getValue() != modified
+                    || index.size() != INDEX_HEADER_LENGTH
+                        + uint64_t(count.getValue()) * INDEX_ENTRY_LENGTH) {
+        return false;
+    }
+
+    EntryMap indexed;
+    unsigned pos = INDEX_HEADER_LENGTH;
+    for (unsigned i = 0; i < count.getValue(); ++i) {
+        coder::Unsigned64 id(encoded.range(pos, 8), coder::bigendian);
+        coder::Unsigned32 offset(encoded.range(pos + 8, 4), coder::bigendian);
+        coder::Unsigned32 len(encoded.range(pos + 12, 4), coder::bigendian);
+        pos += INDEX_ENTRY_LENGTH;
+        Entry entry;
+        entry.offset = offset.getValue();
+        entry.length = len.getValue();
+        if (entry.length == 0 || entry.offset >= length
+                                || entry.length > length - entry.offset
+                                || packetTag(data + entry.offset)
+                                            != CKPGP::Packet::PUBLICKEY) {
+            return false;
+        }
+        indexed[id.getValue()] = entry;
+    }
+
+    entries.swap(indexed);
+    return true;
+
+}
+
+/*
+ * Each certificate starts with a public key packet.
+ */
+void Keyring::scan() {
+
+    uint32_t offset = 0;
+    uint64_t keyID = 0;
+    Entry entry;
+    entry.offset = 0;
+    entry.length = 0;
+    while (offset < length) {
+        unsigned packetLength = PGPCertificate::packetLength(data + offset,
+                                                                length - offset);
+        if (packetTag(data + offset) == CKPGP::Packet::PUBLICKEY) {
+            if (entry.length > 0) {
+                entries[keyID] = entry;
+            }
+            keyID = getKeyID(data + offset, packetLength);
+            entry.offset = offset;
+            entry.length = 0;
+        }
+        else if (offset == 0) {
+            throw EncodingException("Invalid keyring");
+        }
+        entry.length += packetLength;
+        offset += packetLength;
+    }
+    entries[keyID] = entry;
+
+}
+
+void Keyring::writeIndex(const std::string& indexPath) const {
+
+    coder::ByteArray index;
+    index.append(reinterpret_cast<const uint8_t*>(INDEX_MAGIC), 8);
+    coder::Unsigned64 size(length);
+    index.append(size.getEncoded(coder::bigendian));
+    coder::Unsigned64 mtime(modified);
+    index.append(mtime.getEncoded(coder::bigendian));
+    coder::Unsigned32 count(entries.size());
+    index.append(count.getEncoded(coder::bigendian));
+    for (EntryMap::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+        coder::Unsigned64 id(it->first);
+        index.append(id.getEncoded(coder::bigendian));
+        coder::Unsigned32 offset(it->second.offset);
+        index.append(offset.getEncoded(coder::bigendian));
+        coder::Unsigned32 len(it->second.length);
+        index.append(len.getEncoded(coder::bigendian));
+    }
+
+    std::ofstream out(indexPath.c_str(), std::ios::binary | std::ios::trunc);
+    for (unsigned i = 0; i < index.getLength(); ++i) {
+        out.put(index[i]);
+    }
+    if (!out) {
+        throw EncodingException("Keyring index write failed");
+    }
+
+}
+
+}
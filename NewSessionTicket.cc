@@ -0,0 +1,76 @@
+#include "tls/NewSessionTicket.h"
+#include "tls/exceptions/RecordException.h"
+#include <coder/Unsigned16.h>
+#include <coder/Unsigned32.h>
+
+namespace CKTLS {
+
+NewSessionTicket::NewSessionTicket()
+: lifetimeHint(0) {
+}
+
+NewSessionTicket::~NewSessionTicket() {
+}
+
+#ifdef _DEBUG
+void NewSessionTicket::debugOut(std::ostream& out) {
+
+    out << "new_session_ticket" << std::endl;
+    out << "Lifetime hint: " << lifetimeHint << std::endl;
+    out << "Ticket: " << ticket.toString() << std::endl;
+
+}
+#endif
+
+void NewSessionTicket::decode() {
+
+    if (encoded.getLength() < 6) {
+        throw RecordException("Invalid session ticket");
+    }
+
+    coder::Unsigned32 hint(encoded.range(0, 4), coder::bigendian);
+    lifetimeHint = hint.getValue();
+    coder::Unsigned16 tl(encoded.range(4, 2), coder::bigendian);
+    if (tl.getValue() + 6U != encoded.getLength()) {
+        throw RecordException("Invalid session ticket length");
+    }
+    ticket = encoded.range(6, tl.getValue());
+
+}
+
+const coder::ByteArray& NewSessionTicket::encode() {
+
+    encoded.clear();
+    coder::Unsigned32 hint(lifetimeHint);
+    encoded.append(hint.getEncoded(coder::bigendian));
+    coder::Unsigned16 tl(ticket.getLength());
+    encoded.append(tl.getEncoded(coder::bigendian));
+    encoded.append(ticket);
+
+    return encoded;
+
+}
+
+uint32_t NewSessionTicket::getLifetimeHint() const {
+
+    return lifetimeHint;
+
+}
+
+const coder::ByteArray& NewSessionTicket::getTicket() const {
+
+    return ticket;
+
+}
+
+void NewSessionTicket::initState(uint32_t hint, const coder::ByteArray& t) {
+
+    if (t.getLength() > 0xffff) {
+        throw RecordException("Invalid session ticket length");
+    }
+    lifetimeHint = hint;
+    ticket = t;
+
+}
+
+}
@@ -6,6 +6,7 @@
 #include "openpgp/key/String2Key.h"
 #include "openpgp/encode/ArmoredData.h"
 #include <CryptoKitty-C/cipher/AES.h>
+#include <CryptoKitty-C/digest/SHA1.h>
 #include <coder/Unsigned16.h>
 #include <coder/Unsigned32.h>
 
@@ -44,6 +45,7 @@ PGPCertificate::~PGPCertificate() {
 
 PGPCertificate& PGPCertificate::operator= (const PGPCertificate& other) {
 
+    clearBodies();
     publicKey = new CKPGP::PublicKey(*other.publicKey);
     userIds = other.userIds;
     userAttributes = other.userAttributes;
@@ -55,6 +57,7 @@ PGPCertificate& PGPCertificate::operator= (const PGPCertificate& other) {
 
 void PGPCertificate::addUserID(const CKPGP::UserID& uid, const CKPGP::Signature& sig) {
 
+    clearBodies();
     bool found = false;
     for (IdIter it = userIds.begin(); it != userIds.end() && !found; ++it) {
         if (it->id == uid) {
@@ -71,40 +74,36 @@ void PGPCertificate::addUserID(const CKPGP::UserID& uid, const CKPGP::Signature&
 
 }
 
+void PGPCertificate::clearBodies() {
+
+    std::lock_guard<std::mutex> guard(bodyLock);
+    bodies.clear();
+
+}
+
+/*
+ * Each packet is decoded once from a range holding exactly that packet,
+ * so decoding is linear in the size of the certificate.
+ */
 void PGPCertificate::decode(const coder::ByteArray& encoded) {
 
-    CKPGP::Packet *packet = CKPGP::Packet::decodePacket(encoded);
+    unsigned index = 0;
+    CKPGP::Packet *packet = decodePacket(encoded, index);
     if (packet->getTag() != CKPGP::Packet::PUBLICKEY) {
         throw RecordException("Invalid certificate");
     }
     publicKey = dynamic_cast<CKPGP::PublicKey*>(packet);
-    unsigned index = publicKey->getPacketLength() + packet->getHeaderLength();
+    packet = index < encoded.getLength() ? decodePacket(encoded, index) : 0;
 
     bool userSection = true;
-    // Yuck.
-    while (index < encoded.getLength()) {
-        packet = CKPGP::Packet::decodePacket(encoded.range(index,
-                                                        encoded.getLength() - index));
-        index += packet->getPacketLength() + packet->getHeaderLength();
+    while (packet != 0) {
         if (packet->getTag() == CKPGP::Packet::USERID) {
             if (!userSection) {
                 throw RecordException("Invalid certificate");
             }
             SignedID id;
             id.id = dynamic_cast<CKPGP::UserID*>(packet);
-            bool signatures = true;
-            while (index < encoded.getLength() && signatures) {
-                //Peek at the packet before updating the index
-                packet = CKPGP::Packet::decodePacket(encoded.range(index,
-                                                            encoded.getLength() - index));
-                if (packet->getTag() == CKPGP::Packet::SIGNATURE) {
-                    index += packet->getPacketLength() + packet->getHeaderLength();
-                    id.sigs.push_back(dynamic_cast<CKPGP::Signature*>(packet));
-                }
-                else {
-                    signatures = false;
-                }
-            }
+            packet = decodeSignatures(encoded, index, id.sigs);
             userIds.push_back(id);
         }
         else if (packet->getTag() == CKPGP::Packet::USERATTRIBUTE) {
@@ -113,33 +112,28 @@ void PGPCertificate::decode(const coder::ByteArray& encoded) {
             }
             SignedAttr attr;
             attr.attr = dynamic_cast<CKPGP::UserAttribute*>(packet);
-            bool signatures = true;
-            while (index < encoded.getLength() && signatures) {
-                //Peek at the packet before updating the index
-                packet = CKPGP::Packet::decodePacket(encoded.range(index,
-                                                        encoded.getLength() - index));
-                if (packet->getTag() == CKPGP::Packet::SIGNATURE) {
-                    index += packet->getPacketLength() + packet->getHeaderLength();
-                    attr.sigs.push_back(dynamic_cast<CKPGP::Signature*>(packet));
-                }
-                else {
-                    signatures = false;
-                }
-            }
+            packet = decodeSignatures(encoded, index, attr.sigs);
             userAttributes.push_back(attr);
         }
         else if (packet->getTag() == CKPGP::Packet::PUBLICSUBKEY) {
             userSection = false;
             SignedSubkey sub;
             sub.sub = dynamic_cast<CKPGP::PublicSubkey*>(packet);
-            packet = CKPGP::Packet::decodePacket(encoded.range(index, encoded.getLength() - index));
-            index += packet->getPacketLength() + packet->getHeaderLength();
+            if (index >= encoded.getLength()) {
+                throw RecordException("Invalid certificate");
+            }
+            packet = decodePacket(encoded, index);
+            if (packet->getTag() != CKPGP::Packet::SIGNATURE) {
+                throw RecordException("Invalid certificate");
+            }
             sub.sig = dynamic_cast<CKPGP::Signature*>(packet);
             subKeys.push_back(sub);
+            packet = index < encoded.getLength() ? decodePacket(encoded, index) : 0;
         }
         else if (packet->getTag() == CKPGP::Packet::SIGNATURE) {
             userSection = false;
             revocation.push_back(dynamic_cast<CKPGP::Signature*>(packet));
+            packet = index < encoded.getLength() ? decodePacket(encoded, index) : 0;
         }
         else {
             throw RecordException("Invalid certificate");
@@ -169,6 +163,38 @@ void PGPCertificate::decode(std::istream& in) {
 
 }
 
+/*
+ * Decodes the packet at index and advances the index past it.
+ */
+CKPGP::Packet *PGPCertificate::decodePacket(const coder::ByteArray& encoded,
+                                                    unsigned& index) const {
+
+    unsigned length = packetLength(encoded, index);
+    CKPGP::Packet *packet = CKPGP::Packet::decodePacket(encoded.range(index, length));
+    index += length;
+    return packet;
+
+}
+
+/*
+ * Decodes the signatures following a user ID or attribute. Returns the
+ * first packet that isn't a signature, or null at the end of the
+ * certificate.
+ */
+CKPGP::Packet *PGPCertificate::decodeSignatures(const coder::ByteArray& encoded,
+                                        unsigned& index, SignatureList& sigs) const {
+
+    while (index < encoded.getLength()) {
+        CKPGP::Packet *packet = decodePacket(encoded, index);
+        if (packet->getTag() != CKPGP::Packet::SIGNATURE) {
+            return packet;
+        }
+        sigs.push_back(dynamic_cast<CKPGP::Signature*>(packet));
+    }
+    return 0;
+
+}
+
 uint32_t PGPCertificate::decodePGPLength(std::istream& in, coder::ByteArray& lBytes) const {
 
     char octets[5];
@@ -193,6 +219,93 @@ uint32_t PGPCertificate::decodePGPLength(std::istream& in, coder::ByteArray& lBy
 
 }
 
+unsigned PGPCertificate::packetLength(const coder::ByteArray& encoded,
+                                                    unsigned index) const {
+
+    uint8_t header[6];
+    unsigned available = encoded.getLength() - index;
+    for (unsigned i = 0; i < sizeof(header) && i < available; ++i) {
+        header[i] = encoded[index + i];
+    }
+    return packetLength(header, available);
+
+}
+
+/*
+ * Total length, header included, of the packet at the start of data.
+ * Only the packet header is read. See RFC 4880 Section 4.2. Partial
+ * body lengths aren't allowed in certificates.
+ */
+unsigned PGPCertificate::packetLength(const uint8_t *data, unsigned available) {
+
+    if (available < 2 || (data[0] & 0x80) == 0) {
+        throw RecordException("Invalid certificate");
+    }
+
+    uint8_t ctb = data[0];
+    unsigned header;
+    uint32_t body;
+    if ((ctb & 0x40) != 0) {
+        // New format.
+        uint8_t first = data[1];
+        if (first < 192) {
+            header = 2;
+            body = first;
+        }
+        else if (first < 224) {
+            header = 3;
+            if (available < header) {
+                throw RecordException("Invalid certificate");
+            }
+            body = ((first - 192) << 8) + data[2] + 192;
+        }
+        else if (first == 0xff) {
+            header = 6;
+            if (available < header) {
+                throw RecordException("Invalid certificate");
+            }
+            body = (static_cast<uint32_t>(data[2]) << 24) | (data[3] << 16)
+                                                | (data[4] << 8) | data[5];
+        }
+        else {
+            throw RecordException("Invalid certificate");
+        }
+    }
+    else {
+        // Old format.
+        switch (ctb & 0x03) {
+            case 0:
+                header = 2;
+                body = data[1];
+                break;
+            case 1:
+                header = 3;
+                if (available < header) {
+                    throw RecordException("Invalid certificate");
+                }
+                body = (data[1] << 8) | data[2];
+                break;
+            case 2:
+                header = 5;
+                if (available < header) {
+                    throw RecordException("Invalid certificate");
+                }
+                body = (static_cast<uint32_t>(data[1]) << 24) | (data[2] << 16)
+                                                    | (data[3] << 8) | data[4];
+                break;
+            default:
+                // Indeterminate length extends to the end of the data.
+                return available;
+        }
+    }
+
+    if (body > available - header) {
+        throw RecordException("Invalid certificate");
+    }
+    return header + body;
+
+}
+
 coder::ByteArray PGPCertificate::encode() {
 
     // PGP structures are a series of self-contained packets.
@@ -236,14 +349,63 @@ coder::ByteArray PGPCertificate::encode() {
 
 }
 
+PGPCertificate::Body PGPCertificate::getBody(uint64_t keyID, unsigned type) const {
+
+    std::lock_guard<std::mutex> guard(bodyLock);
+    for (unsigned i = 0; i < bodies.size(); ++i) {
+        if (bodies[i].keyID == keyID && bodies[i].type == type) {
+            return bodies[i].body;
+        }
+    }
+    return Body();
+
+}
+
+coder::ByteArray PGPCertificate::getFingerprint() const {
+
+    if (publicKey == 0) {
+        throw RecordException("Invalid public key");
+    }
+
+    // 0x99, two octet length, public key packet body.
+    coder::ByteArray packet(publicKey->getEncoded());
+    unsigned length = publicKey->getPacketLength();
+    coder::ByteArray data(1, 0x99);
+    coder::Unsigned16 len(length);
+    data.append(len.getEncoded(coder::bigendian));
+    data.append(packet.range(publicKey->getHeaderLength(), length));
+
+    CK::SHA1 sha1;
+    return sha1.digest(data);
+
+}
+
 CKPGP::PublicKey *PGPCertificate::getPublicKey() {
 
     return publicKey;
 
 }
 
+void PGPCertificate::setBody(uint64_t keyID, unsigned type, Body body) const {
+
+    std::lock_guard<std::mutex> guard(bodyLock);
+    for (unsigned i = 0; i < bodies.size(); ++i) {
+        if (bodies[i].keyID == keyID && bodies[i].type == type) {
+            bodies[i].body = body;
+            return;
+        }
+    }
+    SharedBody shared;
+    shared.keyID = keyID;
+    shared.type = type;
+    shared.body = body;
+    bodies.push_back(shared);
+
+}
+
 void PGPCertificate::setPublicKey(CKPGP::PublicKey *pk) {
 
+    clearBodies();
     delete publicKey;
     publicKey = pk;
 
@@ -0,0 +1,103 @@
+#include "tls/PRF.h"
+#include "tls/exceptions/StateException.h"
+#include <CryptoKitty-C/digest/SHA256.h>
+#include <CryptoKitty-C/digest/SHA384.h>
+
+namespace CKTLS {
+
+PRF::PRF(PRFAlgorithm alg)
+: digest(0) {
+
+    switch (alg) {
+        case tls_prf_sha256:
+            digest = new CK::SHA256;
+            blockSize = 64;
+            break;
+        case tls_prf_sha384:
+            digest = new CK::SHA384;
+            blockSize = 128;
+            break;
+        default:
+            throw StateException("Invalid PRF algorithm");
+    }
+
+}
+
+PRF::~PRF() {
+
+    delete digest;
+
+}
+
+/*
+ * P_hash(secret, label + seed). A(0) = label + seed,
+ * A(i) = HMAC(A(i-1)), output = HMAC(A(1) + label + seed) +
+ * HMAC(A(2) + label + seed) + ...
+ */
+void PRF::generate(const char *label, const coder::ByteArray& seed,
+                                        uint8_t *output, unsigned length) {
+
+    if (innerPad.getLength() == 0) {
+        throw StateException("PRF secret not set");
+    }
+
+    coder::ByteArray labelSeed(label);
+    labelSeed.append(seed);
+
+    coder::ByteArray a(hmac(labelSeed, coder::ByteArray()));
+    unsigned index = 0;
+    while (index < length) {
+        coder::ByteArray p(hmac(a, labelSeed));
+        unsigned count = p.getLength();
+        if (count > length - index) {
+            count = length - index;
+        }
+        for (unsigned i = 0; i < count; ++i) {
+            output[index++] = p[i];
+        }
+        if (index < length) {
+            a = hmac(a, coder::ByteArray());
+        }
+    }
+
+}
+
+/*
+ * HMAC(K, a + b) using the precomputed pads.
+ */
+coder::ByteArray PRF::hmac(const coder::ByteArray& a, const coder::ByteArray& b) {
+
+    digest->reset();
+    digest->update(innerPad);
+    digest->update(a);
+    coder::ByteArray inner(digest->digest(b));
+
+    digest->reset();
+    digest->update(outerPad);
+    return digest->digest(inner);
+
+}
+
+/*
+ * Precompute the padded keys. Keys longer than the hash block size
+ * are hashed first. See RFC 2104.
+ */
+void PRF::setSecret(const coder::ByteArray& secret) {
+
+    coder::ByteArray key(secret);
+    if (key.getLength() > blockSize) {
+        digest->reset();
+        key = digest->digest(secret);
+    }
+
+    innerPad.setLength(blockSize);
+    outerPad.setLength(blockSize);
+    for (unsigned i = 0; i < blockSize; ++i) {
+        uint8_t k = i < key.getLength() ? key[i] : 0;
+        innerPad[i] = k ^ 0x36;
+        outerPad[i] = k ^ 0x5c;
+    }
+
+}
+
+}
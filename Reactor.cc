@@ -0,0 +1,231 @@
+#if __cplusplus >= 202002L
+
+#include "tls/Reactor.h"
+#include "tls/exceptions/RecordException.h"
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <utility>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace CKTLS {
+
+// Events fetched per epoll_wait.
+static const int MAX_EVENTS = 256;
+
+/*
+ * Coroutine that runs a spawned task to completion and then frees
+ * itself.
+ */
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() {
+            return Detached(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() {}
+    };
+    explicit Detached(std::coroutine_handle<promise_type> h) : handle(h) {}
+    std::coroutine_handle<promise_type> handle;
+};
+
+static Detached detach(Task<void> task) {
+
+    co_await task;
+
+}
+
+Reactor::Reactor()
+: epollfd(-1),
+  postfd(-1),
+  stopping(false) {
+
+    epollfd = ::epoll_create1(EPOLL_CLOEXEC);
+    postfd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollfd < 0 || postfd < 0) {
+        int error = errno;
+        if (epollfd >= 0) {
+            ::close(epollfd);
+        }
+        if (postfd >= 0) {
+            ::close(postfd);
+        }
+        throw RecordException(std::string("Reactor setup failed: ")
+                                                    + std::strerror(error));
+    }
+
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = postfd;
+    ::epoll_ctl(epollfd, EPOLL_CTL_ADD, postfd, &event);
+
+}
+
+Reactor::~Reactor() {
+
+    ::close(epollfd);
+    ::close(postfd);
+
+}
+
+/*
+ * Registrations are oneshot, so each wait re-arms the descriptor for
+ * the union of what its waiters need. A closed descriptor leaves the
+ * epoll set by itself.
+ */
+void Reactor::arm(int fd, const Waiters& waiters) {
+
+    epoll_event event;
+    event.events = EPOLLONESHOT;
+    if (waiters.reader) {
+        event.events |= EPOLLIN | EPOLLRDHUP;
+    }
+    if (waiters.writer) {
+        event.events |= EPOLLOUT;
+    }
+    event.data.fd = fd;
+    if (::epoll_ctl(epollfd, EPOLL_CTL_MOD, fd, &event) < 0) {
+        if (errno != ENOENT
+                    || ::epoll_ctl(epollfd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            throw RecordException(std::string("Reactor watch failed: ")
+                                                    + std::strerror(errno));
+        }
+    }
+
+}
+
+/*
+ * Resume the waiters the events are for. Errors and hang ups wake
+ * both. A waiter the events weren't for is re-armed first, since the
+ * resumed coroutines may wait on the descriptor again.
+ */
+void Reactor::dispatch(int fd, uint32_t events) {
+
+    std::unordered_map<int, Waiters>::iterator it = waiting.find(fd);
+    if (it == waiting.end()) {
+        return;
+    }
+    Waiters& waiters = it->second;
+    std::coroutine_handle<> reader;
+    std::coroutine_handle<> writer;
+    if (events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) {
+        std::swap(reader, waiters.reader);
+    }
+    if (events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+        std::swap(writer, waiters.writer);
+    }
+    if (waiters.reader || waiters.writer) {
+        arm(fd, waiters);
+    }
+    else {
+        waiting.erase(it);
+    }
+
+    if (reader) {
+        reader.resume();
+    }
+    if (writer) {
+        writer.resume();
+    }
+
+}
+
+void Reactor::post(std::coroutine_handle<> handle) {
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        posted.push_back(handle);
+    }
+    uint64_t one = 1;
+    ssize_t count = ::write(postfd, &one, sizeof(one));
+    (void)count;
+
+}
+
+Reactor::Readiness Reactor::readable(int fd) {
+
+    return Readiness(*this, fd, false);
+
+}
+
+void Reactor::run() {
+
+    epoll_event events[MAX_EVENTS];
+    std::vector<std::coroutine_handle<> > ready;
+
+    while (!stopping) {
+        int count = ::epoll_wait(epollfd, events, MAX_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw RecordException(std::string("epoll_wait failed: ")
+                                                    + std::strerror(errno));
+        }
+        for (int i = 0; i < count; ++i) {
+            if (events[i].data.fd == postfd) {
+                uint64_t value;
+                ssize_t n = ::read(postfd, &value, sizeof(value));
+                (void)n;
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    ready.swap(posted);
+                }
+                for (unsigned j = 0; j < ready.size(); ++j) {
+                    ready[j].resume();
+                }
+                ready.clear();
+            }
+            else {
+                dispatch(events[i].data.fd, events[i].events);
+            }
+        }
+    }
+
+}
+
+void Reactor::spawn(Task<void> task) {
+
+    post(detach(std::move(task)).handle);
+
+}
+
+void Reactor::stop() {
+
+    stopping = true;
+    post(std::noop_coroutine());
+
+}
+
+void Reactor::watch(int fd, bool write, std::coroutine_handle<> handle) {
+
+    Waiters& waiters = waiting[fd];
+    if (write) {
+        waiters.writer = handle;
+    }
+    else {
+        waiters.reader = handle;
+    }
+    try {
+        arm(fd, waiters);
+    }
+    catch (...) {
+        (write ? waiters.writer : waiters.reader) = nullptr;
+        throw;
+    }
+
+}
+
+Reactor::Readiness Reactor::writable(int fd) {
+
+    return Readiness(*this, fd, true);
+
+}
+
+}
+
+#endif  // __cplusplus >= 202002L
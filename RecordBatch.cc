@@ -0,0 +1,155 @@
+#include "tls/RecordBatch.h"
+#include "tls/exceptions/RecordException.h"
+#include "tls/exceptions/BadParameterException.h"
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+
+namespace CKTLS {
+
+// Static initialization.
+const unsigned RecordBatch::DEFAULT_CAPACITY = 65536;
+
+// Largest record we will encode. Header plus 2^14 + 2048.
+static const unsigned MAX_RECORD_LENGTH = 5 + 16384 + 2048;
+
+RecordBatch::RecordBatch(unsigned cap)
+: buffer(0),
+  capacity(cap),
+  start(0),
+  end(0),
+  records(0) {
+
+    if (capacity == 0) {
+        throw BadParameterException("Invalid record batch capacity");
+    }
+
+}
+
+RecordBatch::~RecordBatch() {
+
+    delete[] buffer;
+
+}
+
+/*
+ * Encode the record directly into the batch buffer.
+ */
+void RecordBatch::append(RecordProtocol& record) {
+
+    reserve(MAX_RECORD_LENGTH);
+    end += record.encodeRecord(buffer + end, capacity - end);
+    records++;
+
+}
+
+void RecordBatch::append(const uint8_t *data, unsigned length) {
+
+    reserve(length);
+    std::memcpy(buffer + end, data, length);
+    end += length;
+
+}
+
+void RecordBatch::clear() {
+
+    start = end = 0;
+    records = 0;
+
+}
+
+/*
+ * Write as much of the batch as the descriptor will take in one
+ * call. Returns false if the write would block or was partial.
+ * Throws RecordException on a write error.
+ */
+bool RecordBatch::flush(int fd) {
+
+    if (start == end) {
+        return true;
+    }
+
+    ssize_t count = ::write(fd, buffer + start, end - start);
+    if (count < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return false;
+        }
+        throw RecordException(std::string("Record write failed: ")
+                                            + std::strerror(errno));
+    }
+
+    written(count);
+    return start == end;
+
+}
+
+const uint8_t *RecordBatch::getData() const {
+
+    return buffer + start;
+
+}
+
+unsigned RecordBatch::getLength() const {
+
+    return end - start;
+
+}
+
+unsigned RecordBatch::getRecordCount() const {
+
+    return records;
+
+}
+
+/*
+ * Make room for length more bytes. Written bytes are dropped before
+ * the buffer is grown.
+ */
+void RecordBatch::reserve(unsigned length) {
+
+    if (buffer == 0) {
+        while (capacity < length) {
+            capacity *= 2;
+        }
+        buffer = new uint8_t[capacity];
+        return;
+    }
+
+    if (capacity - end >= length) {
+        return;
+    }
+
+    if (start > 0) {
+        std::memmove(buffer, buffer + start, end - start);
+        end -= start;
+        start = 0;
+    }
+
+    if (capacity - end < length) {
+        unsigned newCapacity = capacity * 2;
+        while (newCapacity - end < length) {
+            newCapacity *= 2;
+        }
+        uint8_t *newBuffer = new uint8_t[newCapacity];
+        std::memcpy(newBuffer, buffer, end);
+        delete[] buffer;
+        buffer = newBuffer;
+        capacity = newCapacity;
+    }
+
+}
+
+void RecordBatch::written(unsigned count) {
+
+    if (count > end - start) {
+        throw BadParameterException("Record batch write overrun");
+    }
+
+    start += count;
+    if (start == end) {
+        clear();
+    }
+
+}
+
+}
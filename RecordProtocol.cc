@@ -2,15 +2,21 @@
 #include "tls/HandshakeRecord.h"
 #include "coder/Unsigned16.h"
 #include "tls/exceptions/RecordException.h"
+#include <cstring>
+#include <memory>
 
 namespace CKTLS {
 
 // Static initialization.
 const uint8_t RecordProtocol::MAJOR = 3;
 const uint8_t RecordProtocol::MINOR = 3;
+const unsigned RecordProtocol::HEADER_LENGTH = 5;
 
 RecordProtocol::RecordProtocol(ContentType c)
-: content(c) {
+: content(c),
+  recordMajorVersion(MAJOR),
+  recordMinorVersion(MINOR),
+  fragLength(0) {
 }
 
 RecordProtocol::~RecordProtocol() {
@@ -84,6 +90,66 @@ const coder::ByteArray& RecordProtocol::encodeRecord() {
 
 }
 
+/*
+ * Encode the record into a caller supplied buffer. The header is
+ * written up front and the fragment length is patched in after the
+ * type specific encoding. Throws RecordException if the buffer is
+ * too small.
+ */
+unsigned RecordProtocol::encodeRecord(uint8_t *buffer, unsigned length) {
+
+    if (length < HEADER_LENGTH) {
+        throw RecordException("Record buffer too small");
+    }
+
+    buffer[0] = content;
+    buffer[1] = recordMajorVersion;
+    buffer[2] = recordMinorVersion;
+    // Type specific encoding. Encodes after the header.
+    unsigned fLen = encodeFragment(buffer + HEADER_LENGTH,
+                                                length - HEADER_LENGTH);
+    if (fLen > 0xffff) {
+        throw RecordException("Invalid fragment length");
+    }
+    buffer[3] = (fLen >> 8) & 0xff;
+    buffer[4] = fLen & 0xff;
+    fragLength = fLen;
+
+    return fLen + HEADER_LENGTH;
+
+}
+
+/*
+ * Default fragment encoding. Encodes to fragment and copies it
+ * to the buffer.
+ */
+unsigned RecordProtocol::encodeFragment(uint8_t *buffer, unsigned length) {
+
+    encode();
+    return copyOut(fragment, buffer, length);
+
+}
+
+/*
+ * Copy the byte array to a raw buffer in one block. Returns the
+ * number of bytes copied.
+ */
+unsigned RecordProtocol::copyOut(const coder::ByteArray& src, uint8_t *buffer,
+                                                            unsigned length) {
+
+    unsigned srcLength = src.getLength();
+    if (srcLength > length) {
+        throw RecordException("Record buffer too small");
+    }
+    if (srcLength > 0) {
+        std::unique_ptr<uint8_t[]> bytes(src.asArray());
+        std::memcpy(buffer, bytes.get(), srcLength);
+    }
+
+    return srcLength;
+
+}
+
 const coder::ByteArray& RecordProtocol::getFragment() const {
 
     return fragment;
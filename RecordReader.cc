@@ -0,0 +1,135 @@
+#include "tls/RecordReader.h"
+#include "tls/exceptions/RecordException.h"
+#include "tls/exceptions/BadParameterException.h"
+#include <cstring>
+
+namespace CKTLS {
+
+// Static initialization.
+// 2^14 plus the ciphertext expansion allowed by RFC 5246.
+const unsigned RecordReader::MAX_FRAGMENT_LENGTH = 16384 + 2048;
+// Room for a 64K socket read behind a partial maximum size record.
+const unsigned RecordReader::DEFAULT_CAPACITY = 65536 + 16384 + 2048 + 5;
+
+static const unsigned HEADER_LENGTH = 5;
+
+RecordReader::RecordReader(unsigned cap)
+: buffer(0),
+  capacity(cap),
+  start(0),
+  end(0) {
+
+    if (capacity < MAX_FRAGMENT_LENGTH + HEADER_LENGTH) {
+        throw BadParameterException("Record reader capacity too small");
+    }
+    buffer = new uint8_t[capacity];
+
+}
+
+RecordReader::~RecordReader() {
+
+    delete[] buffer;
+
+}
+
+/*
+ * Copy bytes into the buffer. Used when the bytes have already
+ * been read elsewhere.
+ */
+unsigned RecordReader::append(const uint8_t *data, unsigned length) {
+
+    unsigned available;
+    uint8_t *space = getReadBuffer(available);
+    unsigned count = length < available ? length : available;
+    std::memcpy(space, data, count);
+    end += count;
+    return count;
+
+}
+
+void RecordReader::commit(unsigned count) {
+
+    if (count > capacity - end) {
+        throw BadParameterException("Record reader commit overrun");
+    }
+    end += count;
+
+}
+
+/*
+ * Move the partial record at the front of the buffer. Bytes already
+ * returned as records are dropped, not copied.
+ */
+void RecordReader::compact() {
+
+    if (start == end) {
+        start = end = 0;
+    }
+    else if (start > 0) {
+        std::memmove(buffer, buffer + start, end - start);
+        end -= start;
+        start = 0;
+    }
+
+}
+
+unsigned RecordReader::getBuffered() const {
+
+    return end - start;
+
+}
+
+/*
+ * Returns the free space at the end of the buffer. Compacts only
+ * when the pending partial record would not otherwise fit.
+ */
+uint8_t *RecordReader::getReadBuffer(unsigned& available) {
+
+    if (start == end || capacity - start < MAX_FRAGMENT_LENGTH + HEADER_LENGTH) {
+        compact();
+    }
+    available = capacity - end;
+    return buffer + end;
+
+}
+
+/*
+ * Frame the next record. Throws RecordException if the header is
+ * invalid.
+ */
+bool RecordReader::nextRecord(RecordView& record) {
+
+    if (end - start < HEADER_LENGTH) {
+        return false;
+    }
+
+    uint8_t *header = buffer + start;
+    switch (header[0]) {
+        case change_cipher_spec:
+        case alert:
+        case handshake:
+        case application_data:
+            break;
+        default:
+            throw RecordException("Invalid record content type");
+    }
+    if (header[1] != 3) {
+        throw RecordException("Invalid record version");
+    }
+
+    unsigned fragLength = (header[3] << 8) | header[4];
+    if (fragLength > MAX_FRAGMENT_LENGTH) {
+        throw RecordException("Record overflow");
+    }
+    if (end - start < fragLength + HEADER_LENGTH) {
+        return false;
+    }
+
+    record.data = header;
+    record.length = fragLength + HEADER_LENGTH;
+    start += record.length;
+    return true;
+
+}
+
+}
@@ -7,7 +7,7 @@ namespace CKTLS {
 
 //Static initialization.
 CK::RSAPrivateKey *ServerCertificate::rsaPrivateKey = 0;
-CK::RSAPublicKey *ServerCertificate::rsaPublicKey = 0;
+CertificateCache *ServerCertificate::certificateCache = 0;
 
 ServerCertificate::ServerCertificate()
 : cert(0),
@@ -44,34 +44,92 @@ void ServerCertificate::debugOut(std::ostream& out) {
 void ServerCertificate::decode() {
 
     type = static_cast<OpenPGPCertDescriptorType>(encoded[0]);
-    if (type != subkey_cert) {
+    if (type != subkey_cert && type != subkey_cert_fingerprint) {
         throw RecordException("Invalid certificate type");
     }
 
     uint8_t keySize = encoded[1];
     coder::Unsigned64 id(encoded.range(2, keySize), coder::bigendian);
     keyID = id.getValue();
-    delete cert;
     uint32_t index = keySize + 2;
-    coder::Unsigned16 len(encoded.range(index, 2), coder::bigendian);
-    index += 2;
-    cert = new PGPCertificate(encoded.range(index, len.getValue()));
-    rsaPublicKey = cert->getPublicKey()->getRSAPublicKey();
+
+    CertificateCache::CachedCertificate cached = { 0, 0 };
+    if (type == subkey_cert_fingerprint) {
+        uint8_t fpLength = encoded[index++];
+        if (fpLength < 20 || index + fpLength != encoded.getLength()) {
+            throw RecordException("Invalid certificate fingerprint");
+        }
+        if (certificateCache != 0) {
+            cached = certificateCache->find(encoded.range(index, fpLength));
+        }
+        if (!cached.cert) {
+            throw RecordException("Unknown certificate fingerprint");
+        }
+    }
+    else {
+        coder::Unsigned16 len(encoded.range(index, 2), coder::bigendian);
+        index += 2;
+        coder::ByteArray pgp(encoded.range(index, len.getValue()));
+        if (certificateCache != 0) {
+            cached = certificateCache->decode(pgp);
+        }
+        else {
+            cached.cert.reset(new PGPCertificate(pgp));
+            cached.publicKey = cached.cert->getPublicKey()->getRSAPublicKey();
+        }
+    }
+
+    received = cached.cert;
+    cert = received.get();
 
 }
 
 const coder::ByteArray& ServerCertificate::encode() {
 
-    encoded.append(type);
+    if (!body) {
+        body = getEncoding(cert, keyID, type);
+    }
+    return *body;
+
+}
+
+/*
+ * Returns the certificate's shared encoding, building it if the
+ * certificate has none for this key ID and type. Threads that build
+ * the same body at once each store it, and the last one is kept.
+ */
+ServerCertificate::Encoding ServerCertificate::getEncoding(PGPCertificate *cert,
+                                uint64_t keyID, OpenPGPCertDescriptorType type) {
+
+    if (cert == 0) {
+        throw RecordException("No server certificate");
+    }
+
+    Encoding result(cert->getBody(keyID, type));
+    if (result) {
+        return result;
+    }
+
+    coder::ByteArray *enc = new coder::ByteArray;
+    result.reset(enc);
+    enc->append(type);
     coder::Unsigned64 id(keyID);
-    encoded.append(8);
-    encoded.append(id.getEncoded(coder::bigendian));
-    coder::ByteArray pgp(cert->encode());
-    coder::Unsigned16 len(pgp.getLength());
-    encoded.append(len.getEncoded(coder::bigendian));
-    encoded.append(pgp);
+    enc->append(8);
+    enc->append(id.getEncoded(coder::bigendian));
+    if (type == subkey_cert_fingerprint) {
+        coder::ByteArray fingerprint(cert->getFingerprint());
+        enc->append(fingerprint.getLength());
+        enc->append(fingerprint);
+    }
+    else {
+        coder::ByteArray pgp(cert->encode());
+        coder::Unsigned16 len(pgp.getLength());
+        enc->append(len.getEncoded(coder::bigendian));
+        enc->append(pgp);
+    }
 
-    return encoded;
+    cert->setBody(keyID, type, result);
+    return result;
 
 }
 
@@ -81,27 +139,54 @@ CK::RSAPrivateKey *ServerCertificate::getRSAPrivateKey() {
 
 };
 
-CK::RSAPublicKey *ServerCertificate::getRSAPublicKey() {
-
-    return rsaPublicKey;
-
-};
-
 void ServerCertificate::initState() {
 
      type = subkey_cert;
 
 }
 
+/*
+ * The body is looked up when the message is encoded, after the key ID
+ * and type are set.
+ */
 void ServerCertificate::setCertificate(PGPCertificate *c) {
 
+    if (c != cert) {
+        body.reset();
+    }
     cert = c;
-    rsaPublicKey = cert->getPublicKey()->getRSAPublicKey();
+    if (type == empty_cert) {
+        type = subkey_cert;
+    }
+
+}
+
+void ServerCertificate::setCertificateCache(CertificateCache *cache) {
+
+    certificateCache = cache;
+
+}
+
+/*
+ * Only subkey_cert and subkey_cert_fingerprint are supported.
+ */
+void ServerCertificate::setDescriptorType(OpenPGPCertDescriptorType t) {
+
+    if (t != subkey_cert && t != subkey_cert_fingerprint) {
+        throw RecordException("Invalid certificate type");
+    }
+    if (t != type) {
+        body.reset();
+    }
+    type = t;
 
 }
 
 void ServerCertificate::setKeyID(uint64_t id) {
 
+    if (id != keyID) {
+        body.reset();
+    }
     keyID = id;
 
 }
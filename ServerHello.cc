@@ -22,6 +22,12 @@ ServerHello::ServerHello()
 ServerHello::~ServerHello() {
 }
 
+void ServerHello::addExtension(const Extension& ext) {
+
+    extensions.addExtension(ext);
+
+}
+
 #ifdef _DEBUG
 void ServerHello::debugOut(std::ostream& out) {
 
@@ -127,12 +133,25 @@ CipherSuite ServerHello::getCipherSuite() const {
 
 }
 
+bool ServerHello::getExtension(uint16_t eType, Extension& ext) const {
+
+    ext = extensions.getExtension(eType);
+    return ext.type.getValue() == eType;
+
+}
+
 const coder::ByteArray& ServerHello::getRandom() const {
 
     return random;
 
 }
 
+const coder::ByteArray& ServerHello::getSessionID() const {
+
+    return sessionID;
+
+}
+
 void ServerHello::initState() {
 
     // Not sure if we really need this.
@@ -199,4 +218,16 @@ void ServerHello::initState(const ClientHello& hello) {
 
 }
 
+/*
+ * Sets the session ID. Session IDs are at most 32 bytes.
+ */
+void ServerHello::setSessionID(const coder::ByteArray& id) {
+
+    if (id.getLength() > 32) {
+        throw RecordException("Invalid session ID length");
+    }
+    sessionID = id;
+
+}
+
 }
@@ -1,6 +1,7 @@
 #include "tls/ServerKeyExchange.h"
 #include "tls/ConnectionState.h"
 #include "tls/ServerCertificate.h"
+#include "tls/DHGroup.h"
 #include "tls/exceptions/RecordException.h"
 #include "tls/exceptions/EncodingException.h"
 #include <coder/Unsigned16.h>
@@ -13,19 +14,18 @@
 
 namespace CKTLS {
 
-// Static initialization.
-KeyExchangeAlgorithm ServerKeyExchange::algorithm;
-
 #ifdef _TLS_THREAD_LOCAL_
-ServerKeyExchange::ServerKeyExchange() {
+ServerKeyExchange::ServerKeyExchange()
+: dhGroup(0),
+  hashAlgorithm(sha256) {
+}
 #else
 ServerKeyExchange::ServerKeyExchange(StateContainer *h)
-: holder(h) {
-#endif
-
-    rsaKey = ServerCertificate::getRSAPrivateKey();
-
+: dhGroup(0),
+  hashAlgorithm(sha256),
+  holder(h) {
 }
+#endif
 
 ServerKeyExchange::~ServerKeyExchange() {
 }
@@ -33,14 +33,14 @@ ServerKeyExchange::~ServerKeyExchange() {
 void ServerKeyExchange::decode() {
 
 #ifdef _TLS_THREAD_LOCAL_
-    clientRandom = ConnectionState::getPendingWrite()->getClientRandom();
-    serverRandom = ConnectionState::getPendingWrite()->getServerRandom();
+    ConnectionState *state = ConnectionState::getPendingWrite();
 #else
-    clientRandom = holder->getPendingWrite()->getClientRandom();
-    serverRandom = holder->getPendingWrite()->getServerRandom();
+    ConnectionState *state = holder->getPendingWrite();
 #endif
+    clientRandom = state->getClientRandom();
+    serverRandom = state->getServerRandom();
 
-    switch (algorithm) {
+    switch (state->getKeyExchangeAlgorithm()) {
         case dhe_rsa:
             decodeDH();
             break;
@@ -86,48 +86,13 @@ void ServerKeyExchange::decodeDH() {
     index += length;
 
     //std::cout << "clientRandom = " << clientRandom << std::endl;
-    coder::ByteArray hash(clientRandom);
+    signedData = clientRandom;
     //std::cout << "serverRandom = " << serverRandom << std::endl;
-    hash.append(serverRandom);
+    signedData.append(serverRandom);
     //std::cout << "serverDHParams = " << serverDHParams << std::endl;
-    hash.append(serverDHParams);
+    signedData.append(serverDHParams);
 
-    HashAlgorithm ha = static_cast<HashAlgorithm>(encoded[index++]);
-    CK::Digest *digest;
-    switch (ha) {
-        case sha256:
-            digest = new CK::SHA256;
-            break;
-        case sha384:
-            digest = new CK::SHA384;
-            break;
-        case sha512:
-            digest = new CK::SHA512;
-            break;
-        default:
-            throw EncodingException(std::string("ServerKeyExchange decodeDH: ")
-                            + std::string("Unsupported signature hash algorithm"));
-    }
-
-    SignatureAlgorithm sa = static_cast<SignatureAlgorithm>(encoded[index++]);
-    coder::Unsigned16 siglen(encoded.range(index, 2), coder::bigendian);
-    index += 2;
-    coder::ByteArray sig(encoded.range(index, siglen.getValue()));
-
-    switch (sa) {
-        case rsa:
-            {
-            CK::PKCS1rsassa sign(digest);
-            CK::RSAPublicKey *pubKey = ServerCertificate::getRSAPublicKey();
-            if (!sign.verify(*pubKey, hash, sig)) {
-                dYs = CK::BigInteger::ZERO;
-                throw EncodingException("ServerKeyExchange decodeDH: Key not verified");
-            }
-            }
-            break;
-        default:
-            throw EncodingException("ServerKeyExchange decodeDH: Unsupported signature algorithm");
-    }
+    decodeSignature(index);
 
 }
 
@@ -234,113 +199,97 @@ void ServerKeyExchange::decodeECDH() {
     serverECDH.append(length);
     serverECDH.append(ecPublicKey);
 
-    coder::ByteArray hash(clientRandom);
-    hash.append(serverRandom);
-    hash.append(serverECDH);
+    signedData = clientRandom;
+    signedData.append(serverRandom);
+    signedData.append(serverECDH);
 
-    HashAlgorithm ha = static_cast<HashAlgorithm>(encoded[index++]);
-    CK::Digest *digest;
-    switch (ha) {
-        case sha256:
-            digest = new CK::SHA256;
-            break;
-        case sha384:
-            digest = new CK::SHA384;
-            break;
-        case sha512:
-            digest = new CK::SHA512;
-            break;
-        default:
-            throw EncodingException("Unsupported signature hash algorithm");
-    }
+    decodeSignature(index);
 
-    SignatureAlgorithm sa = static_cast<SignatureAlgorithm>(encoded[index++]);
-    coder::Unsigned16 siglen(encoded.range(index, 2), coder::bigendian);
-    index += 2;
-    coder::ByteArray sig(encoded.range(index, siglen.getValue()));
+}
 
-    switch (sa) {
-        case rsa:
-            {
-            CK::PKCS1rsassa sign(digest);
-            CK::RSAPublicKey *pubKey = ServerCertificate::getRSAPublicKey();
-            if (!sign.verify(*pubKey, hash, sig)) {
-                ecPublicKey.clear();
-                throw EncodingException("ServerKeyExchange decodeECDH: Key not verified");
-            }
-            }
-            break;
-        default:
-            throw EncodingException("ServerKeyExchange decodeECDH: Unsupported signature algorithm");
+/*
+ * Decode the digitally-signed element. The signature is checked by
+ * verify(), once the certificate is known.
+ */
+void ServerKeyExchange::decodeSignature(uint32_t index) {
+
+    hashAlgorithm = static_cast<HashAlgorithm>(encoded[index++]);
+    if (hashAlgorithm != sha256 && hashAlgorithm != sha384
+                                        && hashAlgorithm != sha512) {
+        throw EncodingException("ServerKeyExchange: Unsupported signature hash algorithm");
     }
+    if (static_cast<SignatureAlgorithm>(encoded[index++]) != rsa) {
+        throw EncodingException("ServerKeyExchange: Unsupported signature algorithm");
+    }
+    coder::Unsigned16 siglen(encoded.range(index, 2), coder::bigendian);
+    index += 2;
+    signature = encoded.range(index, siglen.getValue());
 
 }
 
+/*
+ * Encode the message. The parameters are signed here unless a
+ * signature was set.
+ */
 const coder::ByteArray& ServerKeyExchange::encode() {
 
-#ifdef _TLS_THREAD_LOCAL_
-    clientRandom = ConnectionState::getPendingRead()->getClientRandom();
-    serverRandom = ConnectionState::getPendingRead()->getServerRandom();
-#else
-    clientRandom = holder->getPendingRead()->getClientRandom();
-    serverRandom = holder->getPendingRead()->getServerRandom();
-#endif
+    encoded.clear();
+    coder::ByteArray params(encodeParams());
+    encoded.append(params);
 
-    switch (algorithm) {
-        case dhe_rsa:
-            encodeDH();
-            break;
-        case ec_diffie_hellman:
-            encodeECDH();
-            break;
-        default:
-            throw RecordException("ServerKeyExchange encode: Invalid key exchange algorithm");
+    if (signature.getLength() == 0) {
+        coder::ByteArray hash(clientRandom);
+        hash.append(serverRandom);
+        hash.append(params);
+        signature = sign(hash);
     }
 
+    coder::Unsigned16 siglen(signature.getLength());
+    encoded.append(sha256);
+    encoded.append(rsa);
+    encoded.append(siglen.getEncoded(coder::bigendian));
+    encoded.append(signature);
+
     return encoded;
 
 }
 
-void ServerKeyExchange::encodeDH() {
+/*
+ * Encode ServerDHParams.
+ */
+coder::ByteArray ServerKeyExchange::encodeDH() const {
 
     coder::ByteArray serverDHParams;
-    //std::cout << "dP = " << dP << std::endl;
-    coder::ByteArray p(dP.getEncoded(CK::BigInteger::BIGENDIAN));
-    coder::Unsigned16 len(p.getLength());
-    serverDHParams.append(len.getEncoded(coder::bigendian));
-    serverDHParams.append(p);
-    //std::cout << "dG = " << dG << std::endl;
-    coder::ByteArray g(dG.getEncoded(CK::BigInteger::BIGENDIAN));
-    len.setValue(g.getLength());
-    serverDHParams.append(len.getEncoded(coder::bigendian));
-    serverDHParams.append(g);
+    coder::Unsigned16 len;
+    if (dhGroup != 0) {
+        serverDHParams.append(dhGroup->getEncodedParams());
+    }
+    else {
+        //std::cout << "dP = " << dP << std::endl;
+        coder::ByteArray p(dP.getEncoded(CK::BigInteger::BIGENDIAN));
+        len.setValue(p.getLength());
+        serverDHParams.append(len.getEncoded(coder::bigendian));
+        serverDHParams.append(p);
+        //std::cout << "dG = " << dG << std::endl;
+        coder::ByteArray g(dG.getEncoded(CK::BigInteger::BIGENDIAN));
+        len.setValue(g.getLength());
+        serverDHParams.append(len.getEncoded(coder::bigendian));
+        serverDHParams.append(g);
+    }
     //std::cout << "dYs = " << dYs << std::endl;
     coder::ByteArray pk(dYs.getEncoded(CK::BigInteger::BIGENDIAN));
     len.setValue(pk.getLength());
     serverDHParams.append(len.getEncoded(coder::bigendian));
     serverDHParams.append(pk);
-    encoded.append(serverDHParams);
-
-    //std::cout << "clientRandom = " << clientRandom << std::endl;
-    coder::ByteArray hash(clientRandom);
-    //std::cout << "serverRandom = " << serverRandom << std::endl;
-    hash.append(serverRandom);
-    //std::cout << "serverDHParams = " << serverDHParams << std::endl;
-    hash.append(serverDHParams);
-
-    CK::PKCS1rsassa sign(new CK::SHA256);
-    coder::ByteArray sig(sign.sign(*rsaKey, hash));
 
-
-    coder::Unsigned16 siglen(sig.getLength());
-    encoded.append(sha256);
-    encoded.append(rsa);
-    encoded.append(siglen.getEncoded(coder::bigendian));
-    encoded.append(sig);
+    return serverDHParams;
 
 }
 
-void ServerKeyExchange::encodeECDH() {
+/*
+ * Encode ServerECDHParams.
+ */
+coder::ByteArray ServerKeyExchange::encodeECDH() const {
 
     coder::ByteArray params;   // ECParameters
     params.append(curveType);
@@ -389,21 +338,32 @@ void ServerKeyExchange::encodeECDH() {
     coder::ByteArray serverECDH(params);
     serverECDH.append(pk.getLength());
     serverECDH.append(pk);
-    encoded.append(serverECDH);
 
-    coder::ByteArray hash(clientRandom);
-    hash.append(serverRandom);
-    hash.append(serverECDH);
+    return serverECDH;
 
-    CK::PKCS1rsassa sign(new CK::SHA256);
-    coder::ByteArray sig(sign.sign(*rsaKey, hash));
+}
 
+/*
+ * Load the hello randoms and encode the key exchange parameters.
+ */
+coder::ByteArray ServerKeyExchange::encodeParams() {
 
-    coder::Unsigned16 siglen(sig.getLength());
-    encoded.append(sha256);
-    encoded.append(rsa);
-    encoded.append(siglen.getEncoded(coder::bigendian));
-    encoded.append(sig);
+#ifdef _TLS_THREAD_LOCAL_
+    ConnectionState *state = ConnectionState::getPendingRead();
+#else
+    ConnectionState *state = holder->getPendingRead();
+#endif
+    clientRandom = state->getClientRandom();
+    serverRandom = state->getServerRandom();
+
+    switch (state->getKeyExchangeAlgorithm()) {
+        case dhe_rsa:
+            return encodeDH();
+        case ec_diffie_hellman:
+            return encodeECDH();
+        default:
+            throw RecordException("ServerKeyExchange encode: Invalid key exchange algorithm");
+    }
 
 }
 
@@ -416,7 +376,7 @@ CK::ECDHKeyExchange::CurveParams ServerKeyExchange::getCurve() const {
     params.b = curve.b;
     params.xG = baseX;
     params.yG = baseY;
-    params.p - primeP;
+    params.p = primeP;
     params.h = cofactor;
 
     return params;
@@ -447,18 +407,41 @@ const coder::ByteArray& ServerKeyExchange::getECPublicKey() const {
 
 }
 
+coder::ByteArray ServerKeyExchange::getSignedData() {
+
+    coder::ByteArray params(encodeParams());
+    coder::ByteArray data(clientRandom);
+    data.append(serverRandom);
+    data.append(params);
+    return data;
+
+}
+
 void ServerKeyExchange::initState(const CK::BigInteger& g, const CK::BigInteger& p,
                                                     const CK::BigInteger& pk) {
 
+    dhGroup = 0;
     dP = p;
     dG = g;
     dYs = pk;
 
 }
 
+/*
+ * Use a fixed group. The group's cached parameter encoding is used
+ * when the message is encoded.
+ */
+void ServerKeyExchange::initState(const DHGroup& group, const CK::BigInteger& pk) {
+
+    dhGroup = &group;
+    dP = group.getModulus();
+    dG = group.getGenerator();
+    dYs = pk;
+
+}
+
 void ServerKeyExchange::initState(NamedCurve curve, const coder::ByteArray& pk) {
 
-    algorithm = ec_diffie_hellman;
     curveType = named_curve;
     named = curve;
     ecPublicKey = pk;
@@ -468,7 +451,6 @@ void ServerKeyExchange::initState(NamedCurve curve, const coder::ByteArray& pk)
 void ServerKeyExchange::initState(const CK::ECDHKeyExchange::CurveParams& params,
                                                     const coder::ByteArray& pk) {
 
-    algorithm = ec_diffie_hellman;
     curveType = explicit_prime;
 
     primeP = params.p;
@@ -483,9 +465,52 @@ void ServerKeyExchange::initState(const CK::ECDHKeyExchange::CurveParams& params
 
 }
 
-void ServerKeyExchange::setAlgorithm(KeyExchangeAlgorithm alg) {
+void ServerKeyExchange::setSignature(const coder::ByteArray& sig) {
+
+    signature = sig;
+
+}
+
+/*
+ * Verify a decoded message with the key of the certificate the peer
+ * sent. The key exchange values are cleared if it fails.
+ */
+void ServerKeyExchange::verify(const CK::RSAPublicKey& key) {
+
+    CK::Digest *digest;
+    switch (hashAlgorithm) {
+        case sha384:
+            digest = new CK::SHA384;
+            break;
+        case sha512:
+            digest = new CK::SHA512;
+            break;
+        default:
+            digest = new CK::SHA256;
+            break;
+    }
+
+    CK::PKCS1rsassa verifier(digest);
+    if (!verifier.verify(key, signedData, signature)) {
+        dYs = CK::BigInteger::ZERO;
+        ecPublicKey.clear();
+        throw EncodingException("ServerKeyExchange: Key not verified");
+    }
+
+}
+
+/*
+ * Sign with the server certificate's private key. Thread safe.
+ */
+coder::ByteArray ServerKeyExchange::sign(const coder::ByteArray& data) {
+
+    CK::RSAPrivateKey *rsaKey = ServerCertificate::getRSAPrivateKey();
+    if (rsaKey == 0) {
+        throw RecordException("No server private key");
+    }
 
-    algorithm = alg;
+    CK::PKCS1rsassa signer(new CK::SHA256);
+    return signer.sign(*rsaKey, data);
 
 }
 
@@ -0,0 +1,326 @@
+#include "tls/SessionCache.h"
+#include "tls/ConnectionState.h"
+#include "tls/exceptions/BadParameterException.h"
+#include <CryptoKitty-C/random/FortunaSecureRandom.h>
+#include <cstring>
+
+namespace CKTLS {
+
+// Static initialization.
+const unsigned SessionCache::DEFAULT_SIZE = 20000;
+const unsigned SessionCache::DEFAULT_LIFETIME = 3600;
+const unsigned SessionCache::DEFAULT_SHARDS = 64;
+const unsigned SessionCache::WAYS = 4;
+
+static const unsigned MASTER_SECRET_LENGTH = 48;
+
+/*
+ * The shard count is rounded up to a power of two. Each shard holds
+ * an equal part of maxSessions, rounded up to a whole bucket.
+ */
+SessionCache::SessionCache(unsigned maxSessions, unsigned life, unsigned count)
+: shardCount(1),
+  lifetime(life),
+  seed(0) {
+
+    if (maxSessions == 0 || count == 0) {
+        throw BadParameterException("Invalid session cache size");
+    }
+
+    while (shardCount < count) {
+        shardCount = shardCount << 1;
+    }
+    unsigned perShard = (maxSessions + shardCount - 1) / shardCount;
+    bucketCount = (perShard + WAYS - 1) / WAYS;
+
+    coder::ByteArray seedBytes(8, 0);
+    CK::FortunaSecureRandom rnd;
+    rnd.nextBytes(seedBytes);
+    for (unsigned i = 0; i < 8; ++i) {
+        seed = (seed << 8) | seedBytes[i];
+    }
+
+    shards = new Shard[shardCount];
+    unsigned slotCount = bucketCount * WAYS;
+    for (unsigned s = 0; s < shardCount; ++s) {
+        shards[s].slots = new Slot[slotCount];
+        for (unsigned i = 0; i < slotCount; ++i) {
+            Slot& slot(shards[s].slots[i]);
+            slot.sequence.store(0);
+            for (unsigned w = 0; w < SLOT_WORDS; ++w) {
+                slot.words[w].store(0);
+            }
+        }
+        shards[s].hits.store(0);
+        shards[s].misses.store(0);
+        shards[s].evictions.store(0);
+    }
+
+}
+
+SessionCache::~SessionCache() {
+
+    for (unsigned s = 0; s < shardCount; ++s) {
+        delete[] shards[s].slots;
+    }
+    delete[] shards;
+
+}
+
+/*
+ * Returns the first slot of the bucket for this key, and its shard.
+ */
+SessionCache::Slot *SessionCache::bucket(const Key& key, Shard*& shard) {
+
+    uint64_t h = hash(key);
+    shard = shards + (h & (shardCount - 1));
+    return shard->slots + ((h >> 32) % bucketCount) * WAYS;
+
+}
+
+bool SessionCache::find(const coder::ByteArray& id, Session& session) {
+
+    if (id.getLength() == 0 || id.getLength() > 32) {
+        return false;
+    }
+
+    Key key;
+    makeKey(id, key);
+    Shard *shard;
+    Slot *slots = bucket(key, shard);
+    time_t now = time(0);
+
+    uint64_t words[SLOT_WORDS];
+    for (unsigned i = 0; i < WAYS; ++i) {
+        read(slots[i], words);
+        if (matches(words, key)) {
+            time_t created = static_cast<time_t>(words[0]);
+            if (now - created >= lifetime) {
+                break;
+            }
+            session.masterSecret.clear();
+            session.masterSecret.append(reinterpret_cast<uint8_t*>(words + 6),
+                                                        MASTER_SECRET_LENGTH);
+            session.suite = static_cast<CipherSuite>((words[1] >> 8) & 0xffff);
+            session.created = created;
+            shard->hits.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    shard->misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+
+}
+
+uint64_t SessionCache::getEvictions() const {
+
+    uint64_t total = 0;
+    for (unsigned s = 0; s < shardCount; ++s) {
+        total += shards[s].evictions.load(std::memory_order_relaxed);
+    }
+    return total;
+
+}
+
+uint64_t SessionCache::getHits() const {
+
+    uint64_t total = 0;
+    for (unsigned s = 0; s < shardCount; ++s) {
+        total += shards[s].hits.load(std::memory_order_relaxed);
+    }
+    return total;
+
+}
+
+uint64_t SessionCache::getMisses() const {
+
+    uint64_t total = 0;
+    for (unsigned s = 0; s < shardCount; ++s) {
+        total += shards[s].misses.load(std::memory_order_relaxed);
+    }
+    return total;
+
+}
+
+/*
+ * Keyed hash of the session ID. Clients choose the IDs they offer,
+ * so the seed keeps them from aiming at one bucket.
+ */
+uint64_t SessionCache::hash(const Key& key) const {
+
+    uint64_t h = seed ^ key.meta;
+    for (unsigned i = 0; i < 4; ++i) {
+        h ^= key.id[i];
+        h *= 0x9e3779b97f4a7c15ULL;
+        h ^= h >> 29;
+    }
+    return h;
+
+}
+
+void SessionCache::makeKey(const coder::ByteArray& id, Key& key) {
+
+    uint8_t bytes[32];
+    std::memset(bytes, 0, sizeof(bytes));
+    for (unsigned i = 0; i < id.getLength(); ++i) {
+        bytes[i] = id[i];
+    }
+    std::memcpy(key.id, bytes, sizeof(bytes));
+    key.meta = id.getLength();
+
+}
+
+bool SessionCache::matches(const uint64_t *words, const Key& key) {
+
+    return words[0] != 0 && (words[1] & 0xff) == key.meta
+            && words[2] == key.id[0] && words[3] == key.id[1]
+            && words[4] == key.id[2] && words[5] == key.id[3];
+
+}
+
+/*
+ * One generator is shared by all handshakes, so the generator is
+ * seeded once instead of once per session.
+ */
+coder::ByteArray SessionCache::newSessionID() {
+
+    static std::mutex rndLock;
+    static CK::FortunaSecureRandom rnd;
+
+    coder::ByteArray id(32, 0);
+    std::lock_guard<std::mutex> guard(rndLock);
+    rnd.nextBytes(id);
+    return id;
+
+}
+
+/*
+ * Copy a slot without locking. The copy is retried until the
+ * sequence count is even and unchanged across it.
+ */
+void SessionCache::read(Slot& slot, uint64_t *words) {
+
+    uint32_t before;
+    uint32_t after;
+    do {
+        before = slot.sequence.load(std::memory_order_acquire);
+        for (unsigned w = 0; w < SLOT_WORDS; ++w) {
+            words[w] = slot.words[w].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = slot.sequence.load(std::memory_order_relaxed);
+    } while ((before & 1) != 0 || before != after);
+
+}
+
+void SessionCache::remove(const coder::ByteArray& id) {
+
+    if (id.getLength() == 0 || id.getLength() > 32) {
+        return;
+    }
+
+    Key key;
+    makeKey(id, key);
+    Shard *shard;
+    Slot *slots = bucket(key, shard);
+
+    std::lock_guard<std::mutex> guard(shard->lock);
+    uint64_t words[SLOT_WORDS];
+    for (unsigned i = 0; i < WAYS; ++i) {
+        read(slots[i], words);
+        if (matches(words, key)) {
+            std::memset(words, 0, sizeof(words));
+            write(slots[i], words);
+        }
+    }
+
+}
+
+/*
+ * Store the session. A session with the same ID is replaced,
+ * otherwise the session goes in an empty or expired slot, or
+ * replaces the oldest session in the bucket.
+ */
+void SessionCache::store(const coder::ByteArray& id, const ConnectionState& state) {
+
+    if (id.getLength() == 0 || id.getLength() > 32) {
+        throw BadParameterException("Invalid session ID");
+    }
+    const coder::ByteArray& master(state.getMasterSecret());
+    if (master.getLength() != MASTER_SECRET_LENGTH) {
+        throw BadParameterException("Invalid master secret");
+    }
+
+    Key key;
+    makeKey(id, key);
+    uint64_t session[SLOT_WORDS];
+    time_t now = time(0);
+    session[0] = static_cast<uint64_t>(now);
+    session[1] = key.meta | (static_cast<uint64_t>(state.getCipherSuite()) << 8);
+    std::memcpy(session + 2, key.id, sizeof(key.id));
+    uint8_t bytes[MASTER_SECRET_LENGTH];
+    for (unsigned i = 0; i < MASTER_SECRET_LENGTH; ++i) {
+        bytes[i] = master[i];
+    }
+    std::memcpy(session + 6, bytes, sizeof(bytes));
+
+    Shard *shard;
+    Slot *slots = bucket(key, shard);
+    std::lock_guard<std::mutex> guard(shard->lock);
+
+    // Writers hold the shard lock, so the slots can be loaded directly.
+    // The whole bucket is checked for the ID before a free slot is
+    // taken, so an ID is never stored twice.
+    Slot *target = 0;
+    Slot *free = 0;
+    Slot *oldest = slots;
+    uint64_t oldestCreated = ~0ULL;
+    for (unsigned i = 0; i < WAYS && target == 0; ++i) {
+        uint64_t words[SLOT_WORDS];
+        for (unsigned w = 0; w < SLOT_WORDS; ++w) {
+            words[w] = slots[i].words[w].load(std::memory_order_relaxed);
+        }
+        if (matches(words, key)) {
+            target = slots + i;
+        }
+        else if (words[0] == 0
+                        || now - static_cast<time_t>(words[0]) >= lifetime) {
+            if (free == 0) {
+                free = slots + i;
+            }
+        }
+        else if (words[0] < oldestCreated) {
+            oldest = slots + i;
+            oldestCreated = words[0];
+        }
+    }
+    if (target == 0) {
+        target = free;
+    }
+    if (target == 0) {
+        target = oldest;
+        shard->evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    write(*target, session);
+
+}
+
+/*
+ * Update a slot. The caller holds the shard lock. The sequence count
+ * is odd while the words are being written.
+ */
+void SessionCache::write(Slot& slot, const uint64_t *words) {
+
+    uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (unsigned w = 0; w < SLOT_WORDS; ++w) {
+        slot.words[w].store(words[w], std::memory_order_relaxed);
+    }
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+
+}
+
+}
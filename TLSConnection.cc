@@ -0,0 +1,918 @@
+#ifndef _TLS_THREAD_LOCAL_
+
+#include "tls/TLSConnection.h"
+#include "tls/Alert.h"
+#include "tls/ChangeCipherSpec.h"
+#include "tls/CipherText.h"
+#include "tls/ClientHello.h"
+#include "tls/ClientKeyExchange.h"
+#include "tls/DHGroup.h"
+#include "tls/DHKeyPool.h"
+#include "tls/ECDHKeyPool.h"
+#include "tls/Finished.h"
+#include "tls/HandshakeRecord.h"
+#include "tls/KernelTLS.h"
+#include "tls/NewSessionTicket.h"
+#include "tls/ServerCertificate.h"
+#include "tls/ServerHello.h"
+#include "tls/ServerKeyExchange.h"
+#include "tls/SessionCache.h"
+#include "tls/TicketKeyRing.h"
+#include "tls/exceptions/RecordException.h"
+#include "tls/exceptions/StateException.h"
+#include <CryptoKitty-C/keys/ECDHKeyExchange.h>
+#include <CryptoKitty-C/random/FortunaSecureRandom.h>
+#include <cstring>
+
+namespace CKTLS {
+
+// Static initialization.
+PGPCertificate *TLSConnection::serverCert = 0;
+uint64_t TLSConnection::keyID = 0;
+DHKeyPool *TLSConnection::dhPool = 0;
+ECDHKeyPool *TLSConnection::ecdhPool = 0;
+SessionCache *TLSConnection::sessionCache = 0;
+TicketKeyRing *TLSConnection::ticketKeys = 0;
+
+// Largest plaintext fragment. See RFC 5246 Section 6.2.1.
+static const unsigned MAX_PLAINTEXT_LENGTH = 16384;
+// Record header and the most protection may add. See RFC 5246
+// Section 6.2.3.
+static const unsigned MAX_RECORD_EXPANSION = 5 + 2048;
+
+// SessionTicket extension. Empty to offer or accept ticket support.
+static Extension ticketExtension(const coder::ByteArray& ticket) {
+
+    Extension ext;
+    ext.type.setValue(ExtensionManager::SESSION_TICKET);
+    ext.data = ticket;
+    return ext;
+
+}
+
+TLSConnection::TLSConnection(ConnectionEnd e)
+: end(e),
+  state(e == client ? client_start : server_client_hello),
+  resumed(false),
+  ticketExpected(false),
+  deferSigning(false),
+  deferEncoding(false),
+  exchangeAlgorithm(ec_diffie_hellman),
+  kernelFD(-1),
+  notifyPending(false),
+  dhGroup(0),
+  ecdh(0),
+  keyExchange(0) {
+
+    holder.getPendingRead()->setEntity(end);
+    holder.getPendingWrite()->setEntity(end);
+
+}
+
+TLSConnection::~TLSConnection() {
+
+    delete ecdh;
+    delete keyExchange;
+
+}
+
+/*
+ * Send the client's first flight. A session is resumed by ID, or by
+ * ticket with a new session ID that the server echoes to accept the
+ * ticket. See RFC 5077 Section 3.4.
+ */
+void TLSConnection::clientHello() {
+
+    HandshakeRecord hello(client_hello, &holder);
+    ClientHello *ch = dynamic_cast<ClientHello*>(hello.getBody());
+    if (ticket.getLength() > 0) {
+        ch->setSessionID(SessionCache::newSessionID());
+    }
+    else if (sessionID.getLength() > 0) {
+        ch->setSessionID(sessionID);
+    }
+    ch->addExtension(ticketExtension(ticket));
+    clientRandom = ch->getRandom();
+    sessionID = ch->getSessionID();
+    send(hello);
+    state = client_server_hello;
+
+}
+
+void TLSConnection::close() {
+
+    if (state == shut_down) {
+        return;
+    }
+    state = shut_down;
+    // The alert has to follow data waiting to be encoded.
+    if (plaintext.getLength() > 0) {
+        queueRecords(plaintext.getData(), plaintext.getLength());
+        plaintext.clear();
+    }
+    if (kernelFD >= 0) {
+        // The alert has to follow the queued plaintext.
+        notifyPending = true;
+        sendKernelNotify();
+        return;
+    }
+    sendAlert(close_notify, warning);
+
+}
+
+void TLSConnection::commitRead(unsigned count) {
+
+    reader.commit(count);
+
+}
+
+void TLSConnection::deriveKeys(const coder::ByteArray& pre) {
+
+    holder.getPendingRead()->generateKeys(pre);
+    holder.getPendingRead()->setInitialized();
+    holder.getPendingWrite()->generateKeys(pre);
+    holder.getPendingWrite()->setInitialized();
+
+}
+
+/*
+ * Records already encoded, such as handshake messages and alerts, are
+ * copied. Application data waiting to be encoded is then encoded into
+ * the buffer a record at a time while whole records fit.
+ */
+unsigned TLSConnection::encodeOutput(uint8_t *buffer, unsigned length) {
+
+    unsigned count = batch.getLength();
+    if (count > length) {
+        count = length;
+    }
+    if (count > 0) {
+        std::memcpy(buffer, batch.getData(), count);
+        written(count);
+    }
+    if (batch.getLength() > 0) {
+        return count;
+    }
+
+    CipherText record(&holder);
+    while (plaintext.getLength() > 0) {
+        unsigned fragment = plaintext.getLength();
+        if (fragment > MAX_PLAINTEXT_LENGTH) {
+            fragment = MAX_PLAINTEXT_LENGTH;
+        }
+        unsigned room = length - count;
+        if (room < fragment + MAX_RECORD_EXPANSION) {
+            // A smaller record only if nothing else fits.
+            if (count > 0 || room <= MAX_RECORD_EXPANSION) {
+                break;
+            }
+            fragment = room - MAX_RECORD_EXPANSION;
+        }
+        coder::ByteArray data;
+        data.append(plaintext.getData(), fragment);
+        record.setPlaintext(data);
+        count += record.encodeRecord(buffer + count, room);
+        holder.getCurrentRead()->incrementSequence();
+        plaintext.written(fragment);
+    }
+    return count;
+
+}
+
+unsigned TLSConnection::feed(const uint8_t *data, unsigned length) {
+
+    return reader.append(data, length);
+
+}
+
+bool TLSConnection::flush(int fd) {
+
+    bool done = batch.flush(fd);
+    sendKernelNotify();
+    return done && !notifyPending;
+
+}
+
+uint8_t *TLSConnection::getReadBuffer(unsigned& available) {
+
+    return reader.getReadBuffer(available);
+
+}
+
+const uint8_t *TLSConnection::getWriteData(unsigned& length) const {
+
+    length = batch.getLength();
+    return batch.getData();
+
+}
+
+coder::ByteArray TLSConnection::getSignatureData() {
+
+    if (state != server_signing) {
+        throw StateException("No signature pending");
+    }
+    return dynamic_cast<ServerKeyExchange*>(keyExchange->getBody())->getSignedData();
+
+}
+
+/*
+ * Pending output must be sent first, since it was encrypted with
+ * sequence numbers the kernel would otherwise reuse.
+ */
+bool TLSConnection::offload(int fd) {
+
+    if (kernelFD >= 0) {
+        return true;
+    }
+    if (state != established || batch.getLength() > 0
+                                        || plaintext.getLength() > 0) {
+        return false;
+    }
+    if (!KernelTLS::enable(fd, *holder.getCurrentRead(), KernelTLS::transmit)) {
+        return false;
+    }
+    kernelFD = fd;
+    return true;
+
+}
+
+/*
+ * Returns want_write while output is pending, want_read when more
+ * input is needed, want_signature while a deferred ServerKeyExchange
+ * signature is awaited, and complete once the handshake is done and its
+ * last flight has been taken. After close() it returns want_write until
+ * the close_notify is out, then closed. Throws RecordException if the peer
+ * sends an unexpected message or its Finished doesn't verify.
+ */
+TLSConnection::Status TLSConnection::handshake() {
+
+    if (state == shut_down) {
+        return batch.getLength() > 0 || notifyPending ? want_write : closed;
+    }
+    while (state != established && step()) {
+    }
+
+    if (batch.getLength() > 0) {
+        return want_write;
+    }
+    if (state == server_signing) {
+        return want_signature;
+    }
+    return state == established ? complete : want_read;
+
+}
+
+/*
+ * Set the negotiated security parameters on the pending states. The
+ * key exchange is the one the cipher suite calls for.
+ */
+void TLSConnection::negotiate(CipherSuite suite) {
+
+    holder.getPendingRead()->setCipherSuite(suite);
+    holder.getPendingRead()->setClientRandom(clientRandom);
+    holder.getPendingRead()->setServerRandom(serverRandom);
+    holder.getPendingWrite()->setCipherSuite(suite);
+    holder.getPendingWrite()->setClientRandom(clientRandom);
+    holder.getPendingWrite()->setServerRandom(serverRandom);
+    exchangeAlgorithm = holder.getPendingRead()->getKeyExchangeAlgorithm();
+
+}
+
+/*
+ * Decrypts application data into the read buffer. A close_notify
+ * alert returns closed. Any other alert throws RecordException.
+ * Alerts are protected like application data and use up a sequence
+ * number.
+ */
+TLSConnection::Status TLSConnection::read(RecordView& plaintext) {
+
+    if (state == shut_down) {
+        return closed;
+    }
+    if (state != established) {
+        throw StateException("Handshake not complete");
+    }
+
+    RecordView view;
+    if (!reader.nextRecord(view)) {
+        return want_read;
+    }
+    if (view.data[0] != application_data && view.data[0] != alert) {
+        throw RecordException("Unexpected message");
+    }
+
+    CipherText record(&holder, static_cast<ContentType>(view.data[0]));
+    RecordView opened = record.decodeInPlace(view.data, view.length);
+    holder.getCurrentWrite()->incrementSequence();
+    if (record.getRecordType() == alert) {
+        if (opened.length != 2) {
+            throw RecordException("Invalid alert");
+        }
+        Alert received;
+        coder::ByteArray fragment;
+        fragment.append(opened.data, opened.length);
+        received.setFragment(fragment);
+        received.decodeRecord();
+        if (received.getDescription() != close_notify) {
+            throw RecordException("Alert received");
+        }
+        state = shut_down;
+        return closed;
+    }
+
+    plaintext = opened;
+    return complete;
+
+}
+
+/*
+ * Encode application data as records of at most 2^14 bytes onto the
+ * output.
+ */
+void TLSConnection::queueRecords(const uint8_t *data, unsigned length) {
+
+    CipherText record(&holder);
+    unsigned offset = 0;
+    while (offset < length) {
+        unsigned count = length - offset;
+        if (count > MAX_PLAINTEXT_LENGTH) {
+            count = MAX_PLAINTEXT_LENGTH;
+        }
+        coder::ByteArray fragment;
+        fragment.append(data + offset, count);
+        record.setPlaintext(fragment);
+        batch.append(record);
+        holder.getCurrentRead()->incrementSequence();
+        offset += count;
+    }
+
+}
+
+/*
+ * Returns false if no complete record has been buffered. Throws
+ * RecordException if the record isn't of the expected type.
+ */
+bool TLSConnection::receive(RecordProtocol& record) {
+
+    RecordView view;
+    if (!reader.nextRecord(view)) {
+        return false;
+    }
+    if (view.data[0] == alert) {
+        throw RecordException("Alert received");
+    }
+    if (view.data[0] != record.getRecordType()) {
+        throw RecordException("Unexpected message");
+    }
+
+    coder::ByteArray header;
+    header.append(view.data, 5);
+    record.decodePreamble(header);
+    coder::ByteArray fragment;
+    fragment.append(view.data + 5, view.length - 5);
+    record.setFragment(fragment);
+    record.decodeRecord();
+    return true;
+
+}
+
+/*
+ * Receive a plaintext handshake message and add it to the transcript.
+ */
+bool TLSConnection::receive(HandshakeRecord& record, HandshakeType type) {
+
+    if (!receive(record)) {
+        return false;
+    }
+    if (record.getHandshakeType() != type) {
+        throw RecordException("Unexpected handshake message");
+    }
+    transcript.append(record.getFragment());
+    return true;
+
+}
+
+bool TLSConnection::receiveClientHello() {
+
+    HandshakeRecord helloIn(&holder);
+    if (!receive(helloIn, client_hello)) {
+        return false;
+    }
+    ClientHello *ch = dynamic_cast<ClientHello*>(helloIn.getBody());
+
+    HandshakeRecord serverHello(server_hello, &holder);
+    ServerHello *sh = dynamic_cast<ServerHello*>(serverHello.getBody());
+    sh->initState(*ch);
+    clientRandom = ch->getRandom();
+    serverRandom = sh->getRandom();
+
+    Session cached;
+    Extension ext;
+    bool tickets = ch->getExtension(ExtensionManager::SESSION_TICKET, ext)
+                                                        && ticketKeys != 0;
+    if (tickets && ext.data.getLength() > 0) {
+        resumed = ticketKeys->open(ext.data, cached);
+    }
+    if (!resumed && sessionCache != 0 && ch->getSessionID().getLength() > 0) {
+        resumed = sessionCache->find(ch->getSessionID(), cached);
+    }
+    if (resumed && cached.suite != sh->getCipherSuite()) {
+        resumed = false;
+    }
+
+    if (resumed) {
+        sessionID = ch->getSessionID();
+        sh->setSessionID(sessionID);
+        negotiate(cached.suite);
+        send(serverHello);
+        resumeKeys(cached.masterSecret);
+        sendChangeCipherSpec();
+        sendFinished();
+        state = peer_change_cipher_spec;
+    }
+    else {
+        sessionID = SessionCache::newSessionID();
+        sh->setSessionID(sessionID);
+        if (tickets) {
+            sh->addExtension(ticketExtension(coder::ByteArray()));
+            ticketExpected = true;
+        }
+        negotiate(sh->getCipherSuite());
+        send(serverHello);
+        serverFlight();
+        state = deferSigning ? server_signing : server_client_key_exchange;
+    }
+    return true;
+
+}
+
+bool TLSConnection::receiveClientKeyExchange() {
+
+    HandshakeRecord keyExchangeIn(&holder);
+    if (!receive(keyExchangeIn, client_key_exchange)) {
+        return false;
+    }
+    ClientKeyExchange *cke =
+                dynamic_cast<ClientKeyExchange*>(keyExchangeIn.getBody());
+
+    if (exchangeAlgorithm == dhe_rsa) {
+        if (!dhGroup->validPublicKey(cke->getDHPublicKey())) {
+            throw RecordException("Invalid D-H public value");
+        }
+        premaster = cke->getDHPublicKey().modPow(dhSecret, dhGroup->getModulus())
+                                        .getEncoded(CK::BigInteger::BIGENDIAN);
+    }
+    else {
+        premaster = ecdh->getSecret(cke->getECPublicKey());
+        delete ecdh;
+        ecdh = 0;
+    }
+    deriveKeys(premaster);
+    premaster.clear();
+    state = peer_change_cipher_spec;
+    return true;
+
+}
+
+/*
+ * Verify the peer's Finished. It is the first record under the keys
+ * its ChangeCipherSpec switched to, and is opened like application
+ * data. A server finishing a full handshake, or a client finishing an
+ * abbreviated one, sends its own final flight.
+ */
+bool TLSConnection::receiveFinished() {
+
+    RecordView view;
+    if (!reader.nextRecord(view)) {
+        return false;
+    }
+    if (view.data[0] != CKTLS::handshake) {
+        throw RecordException("Unexpected message");
+    }
+    CipherText record(&holder, CKTLS::handshake);
+    RecordView opened = record.decodeInPlace(view.data, view.length);
+    holder.getCurrentWrite()->incrementSequence();
+
+    HandshakeRecord finishedIn(&holder);
+    coder::ByteArray fragment;
+    fragment.append(opened.data, opened.length);
+    finishedIn.setFragment(fragment);
+    finishedIn.decodeRecord();
+    if (finishedIn.getHandshakeType() != finished) {
+        throw RecordException("Unexpected handshake message");
+    }
+    if (!dynamic_cast<Finished*>(finishedIn.getBody())->authenticate(transcript)) {
+        throw RecordException("Finished not authenticated");
+    }
+    transcript.append(finishedIn.getFragment());
+
+    if ((end == server) != resumed) {
+        if (end == server && ticketExpected) {
+            HandshakeRecord newTicket(new_session_ticket, &holder);
+            dynamic_cast<NewSessionTicket*>(newTicket.getBody())->initState(
+                    ticketKeys->getLifetime(), ticketKeys->seal(*holder.getCurrentWrite()));
+            send(newTicket);
+        }
+        sendChangeCipherSpec();
+        sendFinished();
+        if (end == server && sessionCache != 0) {
+            sessionCache->store(sessionID, *holder.getCurrentWrite());
+        }
+    }
+    masterSecret = holder.getCurrentRead()->getMasterSecret();
+    state = established;
+    return true;
+
+}
+
+/*
+ * The session is resumed if the server echoes the offered session ID.
+ */
+bool TLSConnection::receiveServerHello() {
+
+    HandshakeRecord helloIn(&holder);
+    if (!receive(helloIn, server_hello)) {
+        return false;
+    }
+    ServerHello *sh = dynamic_cast<ServerHello*>(helloIn.getBody());
+    serverRandom = sh->getRandom();
+    negotiate(sh->getCipherSuite());
+
+    Extension ext;
+    ticketExpected = sh->getExtension(ExtensionManager::SESSION_TICKET, ext);
+    resumed = masterSecret.getLength() > 0 && sessionID.getLength() > 0
+                                        && sh->getSessionID() == sessionID;
+    if (resumed) {
+        resumeKeys(masterSecret);
+        state = ticketExpected ? client_new_session_ticket
+                                            : peer_change_cipher_spec;
+    }
+    else {
+        sessionID = sh->getSessionID();
+        masterSecret.clear();
+        ticket.clear();
+        state = client_certificate;
+    }
+    return true;
+
+}
+
+/*
+ * Send the client's second flight.
+ */
+bool TLSConnection::receiveServerHelloDone() {
+
+    HandshakeRecord helloDone(&holder);
+    if (!receive(helloDone, server_hello_done)) {
+        return false;
+    }
+
+    send(*keyExchange);
+    delete keyExchange;
+    keyExchange = 0;
+    deriveKeys(premaster);
+    premaster.clear();
+    sendChangeCipherSpec();
+    sendFinished();
+    state = ticketExpected ? client_new_session_ticket : peer_change_cipher_spec;
+    return true;
+
+}
+
+/*
+ * The client key exchange is computed here and sent once the
+ * ServerHelloDone arrives.
+ */
+bool TLSConnection::receiveServerKeyExchange() {
+
+    HandshakeRecord keyExchangeIn(&holder);
+    if (!receive(keyExchangeIn, server_key_exchange)) {
+        return false;
+    }
+    ServerKeyExchange *ske =
+                dynamic_cast<ServerKeyExchange*>(keyExchangeIn.getBody());
+    if (!peerCert) {
+        throw RecordException("No server certificate");
+    }
+    ske->verify(*peerCert->getPublicKey()->getRSAPublicKey());
+
+    keyExchange = new HandshakeRecord(client_key_exchange, &holder);
+    ClientKeyExchange *cke =
+                dynamic_cast<ClientKeyExchange*>(keyExchange->getBody());
+    if (exchangeAlgorithm == dhe_rsa) {
+        const DHGroup *group = DHGroup::find(ske->getDHModulus(),
+                                                    ske->getDHGenerator());
+        if (group == 0) {
+            throw RecordException("Unsupported D-H group");
+        }
+        if (!group->validPublicKey(ske->getDHPublicKey())) {
+            throw RecordException("Invalid D-H public value");
+        }
+        CK::FortunaSecureRandom rnd;
+        CK::BigInteger secret(group->getExponentBits(), rnd);
+        const CK::BigInteger& p(group->getModulus());
+        cke->initState(group->getGenerator().modPow(secret, p));
+        premaster = ske->getDHPublicKey().modPow(secret, p)
+                                        .getEncoded(CK::BigInteger::BIGENDIAN);
+    }
+    else {
+        CK::ECDHKeyExchange exchange(ske->getCurve());
+        cke->initState(secp256r1, exchange.getPublicKey());
+        premaster = exchange.getSecret(ske->getECPublicKey());
+    }
+    state = client_server_hello_done;
+    return true;
+
+}
+
+void TLSConnection::resumeKeys(const coder::ByteArray& master) {
+
+    holder.getPendingRead()->resumeKeys(master);
+    holder.getPendingRead()->setInitialized();
+    holder.getPendingWrite()->resumeKeys(master);
+    holder.getPendingWrite()->setInitialized();
+
+}
+
+/*
+ * Encode a record onto the output batch and add handshake messages
+ * to the transcript.
+ */
+void TLSConnection::send(RecordProtocol& record) {
+
+    batch.append(record);
+    if (record.getRecordType() == CKTLS::handshake) {
+        transcript.append(record.getFragment());
+    }
+
+}
+
+/*
+ * Alerts are protected once there is a current state to send with.
+ */
+void TLSConnection::sendAlert(AlertDescription description, AlertLevel level) {
+
+    ConnectionState *current = holder.getCurrentRead();
+    if (current == 0) {
+        Alert notify(description, level);
+        batch.append(notify);
+        return;
+    }
+
+    coder::ByteArray body;
+    body.append(level);
+    body.append(description);
+    CipherText record(&holder, alert);
+    record.setPlaintext(body);
+    batch.append(record);
+    current->incrementSequence();
+
+}
+
+void TLSConnection::sendChangeCipherSpec() {
+
+    ChangeCipherSpec ccs(&holder);
+    send(ccs);
+    holder.getPendingRead()->promoteRead(&holder);
+
+}
+
+/*
+ * Send the server's ServerKeyExchange, signing it now if no signature
+ * was set, and end the flight.
+ */
+void TLSConnection::sendKeyExchange() {
+
+    send(*keyExchange);
+    delete keyExchange;
+    keyExchange = 0;
+
+    HandshakeRecord helloDone(server_hello_done, &holder);
+    send(helloDone);
+
+}
+
+/*
+ * The close_notify stays pending until the kernel takes it.
+ */
+void TLSConnection::sendKernelNotify() {
+
+    if (notifyPending && batch.getLength() == 0
+                && KernelTLS::sendAlert(kernelFD, close_notify, warning)) {
+        notifyPending = false;
+    }
+
+}
+
+/*
+ * Finished is sent under the keys our ChangeCipherSpec switched to,
+ * like sendAlert().
+ */
+void TLSConnection::sendFinished() {
+
+    HandshakeRecord fin(finished, &holder);
+    dynamic_cast<Finished*>(fin.getBody())->initState(transcript);
+    fin.encodeRecord();
+    transcript.append(fin.getFragment());
+
+    CipherText record(&holder, CKTLS::handshake);
+    record.setPlaintext(fin.getFragment());
+    batch.append(record);
+    holder.getCurrentRead()->incrementSequence();
+
+}
+
+void TLSConnection::setCertificate(PGPCertificate *cert, uint64_t id) {
+
+    serverCert = cert;
+    keyID = id;
+
+}
+
+void TLSConnection::setDHKeyPool(DHKeyPool *pool) {
+
+    dhPool = pool;
+
+}
+
+void TLSConnection::setECDHKeyPool(ECDHKeyPool *pool) {
+
+    ecdhPool = pool;
+
+}
+
+void TLSConnection::setSignature(const coder::ByteArray& signature) {
+
+    if (state != server_signing) {
+        throw StateException("No signature pending");
+    }
+    dynamic_cast<ServerKeyExchange*>(keyExchange->getBody())->setSignature(signature);
+    sendKeyExchange();
+    state = server_client_key_exchange;
+
+}
+
+void TLSConnection::setSession(const coder::ByteArray& id,
+                const coder::ByteArray& master, const coder::ByteArray& t) {
+
+    if (end != client || state != client_start) {
+        throw StateException("Session can only be set before a client handshake");
+    }
+    sessionID = id;
+    masterSecret = master;
+    ticket = t;
+
+}
+
+void TLSConnection::setSessionCache(SessionCache *cache) {
+
+    sessionCache = cache;
+
+}
+
+void TLSConnection::setTicketKeyRing(TicketKeyRing *ring) {
+
+    ticketKeys = ring;
+
+}
+
+/*
+ * Send the Certificate, ServerKeyExchange and ServerHelloDone of a
+ * full handshake.
+ */
+void TLSConnection::serverFlight() {
+
+    if (serverCert == 0) {
+        throw StateException("No server certificate");
+    }
+    HandshakeRecord cert(certificate, &holder);
+    ServerCertificate *sc = dynamic_cast<ServerCertificate*>(cert.getBody());
+    sc->setKeyID(keyID);
+    sc->setCertificate(serverCert);
+    send(cert);
+
+    keyExchange = new HandshakeRecord(server_key_exchange, &holder);
+    ServerKeyExchange *ske =
+                dynamic_cast<ServerKeyExchange*>(keyExchange->getBody());
+    if (exchangeAlgorithm == dhe_rsa) {
+        CK::BigInteger publicKey;
+        if (dhPool != 0) {
+            DHKey key(dhPool->pop());
+            dhGroup = &dhPool->getGroup();
+            dhSecret = key.secret;
+            publicKey = key.publicKey;
+        }
+        else {
+            CK::FortunaSecureRandom rnd;
+            dhGroup = &DHGroup::ffdhe2048();
+            dhSecret = CK::BigInteger(dhGroup->getExponentBits(), rnd);
+            publicKey = dhGroup->getGenerator().modPow(dhSecret,
+                                                    dhGroup->getModulus());
+        }
+        ske->initState(*dhGroup, publicKey);
+    }
+    else {
+        coder::ByteArray publicKey;
+        if (ecdhPool != 0) {
+            ECDHKey key(ecdhPool->pop(secp256r1));
+            ecdh = key.exchange;
+            publicKey = key.publicKey;
+        }
+        else {
+            ecdh = new CK::ECDHKeyExchange(CK::ECDHKeyExchange::SECP256R1);
+            publicKey = ecdh->getPublicKey();
+        }
+        ske->initState(secp256r1, publicKey);
+    }
+    if (!deferSigning) {
+        sendKeyExchange();
+    }
+
+}
+
+/*
+ * Take one handshake step. Returns false if more input is needed.
+ */
+bool TLSConnection::step() {
+
+    switch (state) {
+        case client_start:
+            clientHello();
+            return true;
+        case client_server_hello:
+            return receiveServerHello();
+        case client_certificate:
+            {
+            HandshakeRecord certIn(&holder);
+            if (!receive(certIn, certificate)) {
+                return false;
+            }
+            peerCert = dynamic_cast<ServerCertificate*>(certIn.getBody())->getReceived();
+            state = client_server_key_exchange;
+            return true;
+            }
+        case client_server_key_exchange:
+            return receiveServerKeyExchange();
+        case client_server_hello_done:
+            return receiveServerHelloDone();
+        case client_new_session_ticket:
+            {
+            HandshakeRecord ticketIn(&holder);
+            if (!receive(ticketIn, new_session_ticket)) {
+                return false;
+            }
+            ticket = dynamic_cast<NewSessionTicket*>(ticketIn.getBody())->getTicket();
+            state = peer_change_cipher_spec;
+            return true;
+            }
+        case server_client_hello:
+            return receiveClientHello();
+        case server_client_key_exchange:
+            return receiveClientKeyExchange();
+        case peer_change_cipher_spec:
+            {
+            ChangeCipherSpec ccs(&holder);
+            if (!receive(ccs)) {
+                return false;
+            }
+            holder.getPendingWrite()->promoteWrite(&holder);
+            state = peer_finished;
+            return true;
+            }
+        case peer_finished:
+            return receiveFinished();
+        default:
+            return false;
+    }
+
+}
+
+TLSConnection::Status TLSConnection::write(const uint8_t *data, unsigned length) {
+
+    if (state != established) {
+        throw StateException("Handshake not complete");
+    }
+
+    if (kernelFD >= 0) {
+        batch.append(data, length);
+    }
+    else if (deferEncoding) {
+        plaintext.append(data, length);
+    }
+    else {
+        queueRecords(data, length);
+    }
+    return want_write;
+
+}
+
+void TLSConnection::written(unsigned count) {
+
+    batch.written(count);
+    sendKernelNotify();
+
+}
+
+}
+
+#endif  // _TLS_THREAD_LOCAL_
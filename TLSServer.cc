@@ -0,0 +1,817 @@
+#ifndef _TLS_THREAD_LOCAL_
+
+#include "tls/TLSServer.h"
+#include "tls/IOUring.h"
+#include "tls/TLSConnection.h"
+#include "tls/exceptions/BadParameterException.h"
+#include "tls/exceptions/RecordException.h"
+#include "tls/exceptions/StateException.h"
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace CKTLS {
+
+// Static initialization.
+const unsigned TLSServer::DEFAULT_THREADS = 4;
+const unsigned TLSServer::MAX_EVENTS = 256;
+const unsigned TLSServer::DEFAULT_MAX_CONNECTIONS = 1024;
+// One record of the largest size. See RFC 5246 Section 6.2.3.
+const unsigned TLSServer::SLOT_LENGTH = 5 + 16384 + 2048;
+
+// io_uring completion tags. Connection addresses are at least 8 byte
+// aligned, so the low bit marks writes.
+static const uint64_t WRITE_TAG = 1;
+static const uint64_t ACCEPT_TAG = 2;
+static const uint64_t STOP_TAG = 4;
+static const uint64_t RETRY_TAG = 6;
+
+// Wait before accepting again after a failed accept, in milliseconds.
+static const unsigned MIN_ACCEPT_BACKOFF = 10;
+static const unsigned MAX_ACCEPT_BACKOFF = 1000;
+
+/*
+ * A connection and its socket. Owned by one loop.
+ */
+struct TLSServer::Connection {
+    Connection(int f)
+    : fd(f),
+      tls(server),
+      writing(false),
+      open(true),
+      closing(false),
+      offloadTried(false),
+      slot(0),
+      writeOffset(0),
+      writeLength(0),
+      inflight(0) {
+    }
+    int fd;
+    TLSConnection tls;
+    bool writing;           // Waiting for EPOLLOUT, or io_uring write in flight.
+    bool open;
+    bool closing;           // Close once the last write completes.
+    bool offloadTried;
+    uint8_t *slot;          // Registered write buffer slot.
+    unsigned writeOffset;
+    unsigned writeLength;
+    unsigned inflight;      // io_uring operations not yet completed.
+};
+
+TLSServer::TLSServer(uint16_t p, unsigned threads, IOBackend b)
+: port(p),
+  backend(b),
+  maxConnections(DEFAULT_MAX_CONNECTIONS),
+  kernelTLS(false),
+  loops(threads),
+  running(false),
+  active(0),
+  handshakes(0) {
+
+    if (threads == 0) {
+        throw BadParameterException("Invalid server thread count");
+    }
+    for (unsigned i = 0; i < threads; ++i) {
+        loops[i].epollfd = loops[i].listenfd = loops[i].stopfd = -1;
+        loops[i].sparefd = -1;
+        loops[i].ring = 0;
+        loops[i].buffer = 0;
+        loops[i].stopValue = 0;
+        loops[i].acceptBackoff = 0;
+    }
+
+}
+
+TLSServer::~TLSServer() {
+
+    stop();
+
+}
+
+void TLSServer::accept(Loop& loop) {
+
+    for (;;) {
+        int fd = ::accept4(loop.listenfd, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if ((errno == EMFILE || errno == ENFILE) && shed(loop)) {
+                continue;
+            }
+            // EAGAIN, or out of memory.
+            return;
+        }
+        accepted(loop, fd);
+    }
+
+}
+
+/*
+ * Start watching, or receiving on, a new connection.
+ */
+void TLSServer::accepted(Loop& loop, int fd) {
+
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    Connection *connection;
+    if (backend == uring_io) {
+        if (loop.slots.empty()) {
+            ::close(fd);
+            return;
+        }
+        connection = new Connection(fd);
+        connection->slot = loop.slots.back();
+        loop.slots.pop_back();
+        connection->tls.setDeferredEncoding(true);
+    }
+    else {
+        connection = new Connection(fd);
+        epoll_event event;
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.ptr = connection;
+        if (::epoll_ctl(loop.epollfd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            ::close(fd);
+            delete connection;
+            return;
+        }
+    }
+    loop.connections.insert(connection);
+    active++;
+
+    if (backend == uring_io) {
+        try {
+            receive(loop, connection);
+        }
+        catch (...) {
+            close(loop, connection);
+        }
+    }
+
+}
+
+/*
+ * The connection is deleted once the current batch of events has
+ * been handled, since later events in the batch may refer to it.
+ * With io_uring it is kept until its operations complete; shutting
+ * the socket down completes them.
+ */
+void TLSServer::close(Loop& loop, Connection *connection) {
+
+    if (!connection->open) {
+        return;
+    }
+    connection->open = false;
+    if (backend == uring_io) {
+        ::shutdown(connection->fd, SHUT_RDWR);
+    }
+    else {
+        ::epoll_ctl(loop.epollfd, EPOLL_CTL_DEL, connection->fd, 0);
+    }
+    ::close(connection->fd);
+    if (closeCallback) {
+        closeCallback(connection->tls);
+    }
+    loop.connections.erase(connection);
+    loop.closed.push_back(connection);
+    active--;
+
+}
+
+void TLSServer::closeLoop(Loop& loop) {
+
+    if (loop.listenfd >= 0) {
+        ::close(loop.listenfd);
+    }
+    if (loop.epollfd >= 0) {
+        ::close(loop.epollfd);
+    }
+    if (loop.stopfd >= 0) {
+        ::close(loop.stopfd);
+    }
+    if (loop.sparefd >= 0) {
+        ::close(loop.sparefd);
+    }
+    loop.epollfd = loop.listenfd = loop.stopfd = loop.sparefd = -1;
+    delete loop.ring;
+    loop.ring = 0;
+    delete[] loop.buffer;
+    loop.buffer = 0;
+    loop.slots.clear();
+
+}
+
+/*
+ * Write as much pending output as the socket will take, and wait for
+ * EPOLLOUT while any is left.
+ */
+void TLSServer::flush(Loop& loop, Connection *connection) {
+
+    if (backend == uring_io) {
+        send(loop, connection);
+        return;
+    }
+
+    unsigned length;
+    const uint8_t *data = connection->tls.getWriteData(length);
+    while (length > 0) {
+        ssize_t count = ::send(connection->fd, data, length, MSG_NOSIGNAL);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            throw RecordException(std::string("Connection write failed: ")
+                                                    + std::strerror(errno));
+        }
+        connection->tls.written(count);
+        data = connection->tls.getWriteData(length);
+    }
+
+    bool pending = length > 0;
+    if (!pending) {
+        offload(connection);
+    }
+    if (pending != connection->writing) {
+        epoll_event event;
+        event.events = EPOLLIN | EPOLLRDHUP | (pending ? EPOLLOUT : 0);
+        event.data.ptr = connection;
+        ::epoll_ctl(loop.epollfd, EPOLL_CTL_MOD, connection->fd, &event);
+        connection->writing = pending;
+    }
+
+}
+
+/*
+ * Read until the socket would block, processing records as they
+ * arrive so the read buffer never fills. Any error closes the
+ * connection.
+ */
+void TLSServer::handle(Loop& loop, Connection *connection, uint32_t events) {
+
+    if (!connection->open) {
+        return;
+    }
+
+    try {
+        bool open = (events & EPOLLERR) == 0;
+        if (open && (events & (EPOLLIN | EPOLLHUP | EPOLLRDHUP)) != 0) {
+            while (open) {
+                unsigned available;
+                uint8_t *space = connection->tls.getReadBuffer(available);
+                ssize_t count = ::read(connection->fd, space, available);
+                if (count > 0) {
+                    connection->tls.commitRead(count);
+                    open = process(connection);
+                }
+                else if (count == 0) {
+                    open = false;
+                }
+                else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;
+                }
+                else if (errno != EINTR) {
+                    open = false;
+                }
+            }
+        }
+        // Best effort delivery of a close_notify before closing.
+        flush(loop, connection);
+        if (!open) {
+            close(loop, connection);
+        }
+    }
+    // Protocol and crypto errors of any kind only close the connection.
+    catch (...) {
+        close(loop, connection);
+    }
+
+}
+
+/*
+ * Listening socket, epoll instance and stop event for one loop.
+ */
+void TLSServer::open(Loop& loop) {
+
+    // io_uring waits for blocking sockets itself.
+    int nonblock = backend == uring_io ? 0 : SOCK_NONBLOCK;
+    loop.listenfd = ::socket(AF_INET, SOCK_STREAM | nonblock | SOCK_CLOEXEC, 0);
+    if (loop.listenfd < 0) {
+        throw RecordException(std::string("Server socket failed: ")
+                                                    + std::strerror(errno));
+    }
+    int one = 1;
+    ::setsockopt(loop.listenfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (::setsockopt(loop.listenfd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+        throw RecordException(std::string("SO_REUSEPORT failed: ")
+                                                    + std::strerror(errno));
+    }
+
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (::bind(loop.listenfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0
+                                    || ::listen(loop.listenfd, SOMAXCONN) < 0) {
+        throw RecordException(std::string("Server listen failed: ")
+                                                    + std::strerror(errno));
+    }
+
+    if (backend == uring_io) {
+        loop.stopfd = ::eventfd(0, EFD_CLOEXEC);
+        if (loop.stopfd < 0) {
+            throw RecordException(std::string("Server event setup failed: ")
+                                                    + std::strerror(errno));
+        }
+        loop.ring = new IOUring(2 * maxConnections + 2);
+        const unsigned needed[] = { IORING_OP_ACCEPT, IORING_OP_READ,
+                        IORING_OP_RECV, IORING_OP_TIMEOUT, IORING_OP_WRITE_FIXED };
+        for (unsigned i = 0; i < sizeof(needed) / sizeof(needed[0]); ++i) {
+            if (!loop.ring->supports(needed[i])) {
+                throw RecordException("io_uring operation not supported");
+            }
+        }
+        loop.buffer = new uint8_t[maxConnections * SLOT_LENGTH];
+        loop.ring->registerBuffer(loop.buffer, maxConnections * SLOT_LENGTH);
+        for (unsigned i = 0; i < maxConnections; ++i) {
+            loop.slots.push_back(loop.buffer + i * SLOT_LENGTH);
+        }
+        return;
+    }
+
+    loop.epollfd = ::epoll_create1(EPOLL_CLOEXEC);
+    loop.stopfd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    loop.sparefd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (loop.epollfd < 0 || loop.stopfd < 0 || loop.sparefd < 0) {
+        throw RecordException(std::string("Server event setup failed: ")
+                                                    + std::strerror(errno));
+    }
+
+    // Loop descriptors are told apart from connections by address.
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = &loop.listenfd;
+    ::epoll_ctl(loop.epollfd, EPOLL_CTL_ADD, loop.listenfd, &event);
+    event.data.ptr = &loop.stopfd;
+    ::epoll_ctl(loop.epollfd, EPOLL_CTL_ADD, loop.stopfd, &event);
+
+}
+
+/*
+ * Open every loop, or none.
+ */
+void TLSServer::openLoops() {
+
+    try {
+        for (unsigned i = 0; i < loops.size(); ++i) {
+            open(loops[i]);
+        }
+    }
+    catch (...) {
+        for (unsigned i = 0; i < loops.size(); ++i) {
+            closeLoop(loops[i]);
+        }
+        throw;
+    }
+
+}
+
+/*
+ * Try kernel TLS once, after the handshake output has been sent.
+ */
+void TLSServer::offload(Connection *connection) {
+
+    if (kernelTLS && !connection->offloadTried
+                                && connection->tls.isEstablished()) {
+        connection->offloadTried = true;
+        connection->tls.offload(connection->fd);
+    }
+
+}
+
+/*
+ * Drive the handshake, then hand application data to the callback.
+ * Returns false if the connection should be closed.
+ */
+bool TLSServer::process(Connection *connection) {
+
+    TLSConnection& tls(connection->tls);
+    if (!tls.isEstablished()) {
+        if (tls.handshake() == TLSConnection::closed) {
+            return false;
+        }
+        if (!tls.isEstablished()) {
+            return true;
+        }
+        handshakes++;
+        if (establishedCallback) {
+            establishedCallback(tls);
+        }
+    }
+
+    RecordView view;
+    for (;;) {
+        switch (tls.read(view)) {
+            case TLSConnection::want_read:
+                return true;
+            case TLSConnection::closed:
+                return false;
+            default:
+                if (dataCallback) {
+                    dataCallback(tls, view.data, view.length);
+                }
+                break;
+        }
+    }
+
+}
+
+/*
+ * Receive straight into the connection's record reader.
+ */
+void TLSServer::receive(Loop& loop, Connection *connection) {
+
+    unsigned available;
+    uint8_t *space = connection->tls.getReadBuffer(available);
+    io_uring_sqe *sqe = loop.ring->getSQE();
+    if (sqe == 0) {
+        throw RecordException("io_uring submission queue full");
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = connection->fd;
+    sqe->addr = reinterpret_cast<uint64_t>(space);
+    sqe->len = available;
+    sqe->user_data = reinterpret_cast<uint64_t>(connection);
+    connection->inflight++;
+
+}
+
+void TLSServer::received(Loop& loop, Connection *connection, int result) {
+
+    connection->inflight--;
+    if (!connection->open) {
+        return;
+    }
+
+    try {
+        if (result == -EINTR || result == -EAGAIN) {
+            receive(loop, connection);
+            return;
+        }
+        if (result <= 0) {
+            close(loop, connection);
+            return;
+        }
+        connection->tls.commitRead(result);
+        bool open = process(connection);
+        send(loop, connection);
+        if (open) {
+            receive(loop, connection);
+        }
+        else if (connection->writing) {
+            // Deliver the close_notify first.
+            connection->closing = true;
+        }
+        else {
+            close(loop, connection);
+        }
+    }
+    catch (...) {
+        close(loop, connection);
+    }
+
+}
+
+/*
+ * Delete closed connections that have no operations in flight.
+ */
+void TLSServer::release(Loop& loop) {
+
+    unsigned kept = 0;
+    for (unsigned i = 0; i < loop.closed.size(); ++i) {
+        Connection *connection = loop.closed[i];
+        if (connection->inflight > 0) {
+            loop.closed[kept++] = connection;
+        }
+        else {
+            if (connection->slot != 0) {
+                loop.slots.push_back(connection->slot);
+            }
+            delete connection;
+        }
+    }
+    loop.closed.resize(kept);
+
+}
+
+/*
+ * Accept failed for want of descriptors or memory, and would fail
+ * again at once. Accept again after a timeout, doubled while failures
+ * continue, so that connections can close in the meantime.
+ */
+void TLSServer::retryAccept(Loop& loop) {
+
+    loop.acceptBackoff = loop.acceptBackoff == 0 ? MIN_ACCEPT_BACKOFF
+                                                : loop.acceptBackoff * 2;
+    if (loop.acceptBackoff > MAX_ACCEPT_BACKOFF) {
+        loop.acceptBackoff = MAX_ACCEPT_BACKOFF;
+    }
+    loop.acceptDelay.tv_sec = loop.acceptBackoff / 1000;
+    loop.acceptDelay.tv_nsec = (loop.acceptBackoff % 1000) * 1000000LL;
+
+    io_uring_sqe *sqe = loop.ring->getSQE();
+    if (sqe == 0) {
+        throw RecordException("io_uring submission queue full");
+    }
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->addr = reinterpret_cast<uint64_t>(&loop.acceptDelay);
+    sqe->len = 1;
+    sqe->user_data = RETRY_TAG;
+
+}
+
+void TLSServer::run(Loop& loop) {
+
+    std::vector<epoll_event> events(MAX_EVENTS);
+    bool stopping = false;
+    while (!stopping) {
+        int count = ::epoll_wait(loop.epollfd, &events[0], MAX_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        for (int i = 0; i < count; ++i) {
+            void *ptr = events[i].data.ptr;
+            if (ptr == &loop.stopfd) {
+                stopping = true;
+            }
+            else if (ptr == &loop.listenfd) {
+                accept(loop);
+            }
+            else {
+                handle(loop, static_cast<Connection*>(ptr), events[i].events);
+            }
+        }
+        release(loop);
+    }
+
+    while (!loop.connections.empty()) {
+        close(loop, *loop.connections.begin());
+    }
+    release(loop);
+
+}
+
+/*
+ * Every pass submits all queued operations and waits for completions
+ * with one io_uring_enter.
+ */
+void TLSServer::runUring(Loop& loop) {
+
+    IOUring& ring(*loop.ring);
+    submitAccept(loop);
+    io_uring_sqe *sqe = ring.getSQE();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = loop.stopfd;
+    sqe->addr = reinterpret_cast<uint64_t>(&loop.stopValue);
+    sqe->len = sizeof(loop.stopValue);
+    sqe->user_data = STOP_TAG;
+
+    bool stopping = false;
+    while (!stopping || !loop.closed.empty()) {
+        ring.submit(1);
+        io_uring_cqe *cqe;
+        while ((cqe = ring.peekCQE()) != 0) {
+            uint64_t data = cqe->user_data;
+            int result = cqe->res;
+            ring.seen();
+            if (data == ACCEPT_TAG) {
+                if (stopping) {
+                    if (result >= 0) {
+                        ::close(result);
+                    }
+                }
+                else if (result >= 0) {
+                    loop.acceptBackoff = 0;
+                    accepted(loop, result);
+                    submitAccept(loop);
+                }
+                else if (result == -EINTR || result == -EAGAIN
+                                        || result == -ECONNABORTED) {
+                    submitAccept(loop);
+                }
+                else {
+                    retryAccept(loop);
+                }
+            }
+            else if (data == RETRY_TAG) {
+                if (!stopping) {
+                    submitAccept(loop);
+                }
+            }
+            else if (data == STOP_TAG) {
+                stopping = true;
+                while (!loop.connections.empty()) {
+                    close(loop, *loop.connections.begin());
+                }
+            }
+            else if ((data & WRITE_TAG) != 0) {
+                sent(loop, reinterpret_cast<Connection*>(data & ~WRITE_TAG), result);
+            }
+            else {
+                received(loop, reinterpret_cast<Connection*>(data), result);
+            }
+        }
+        release(loop);
+    }
+
+}
+
+/*
+ * Encode pending output into the connection's registered slot and
+ * write it. Application data is encrypted straight into the slot. One
+ * write per connection is in flight at a time.
+ */
+void TLSServer::send(Loop& loop, Connection *connection) {
+
+    if (connection->writing) {
+        return;
+    }
+    if (connection->writeOffset == connection->writeLength) {
+        unsigned length = connection->tls.encodeOutput(connection->slot,
+                                                            SLOT_LENGTH);
+        if (length == 0) {
+            offload(connection);
+            return;
+        }
+        connection->writeOffset = 0;
+        connection->writeLength = length;
+    }
+
+    io_uring_sqe *sqe = loop.ring->getSQE();
+    if (sqe == 0) {
+        throw RecordException("io_uring submission queue full");
+    }
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->fd = connection->fd;
+    sqe->addr = reinterpret_cast<uint64_t>(connection->slot + connection->writeOffset);
+    sqe->len = connection->writeLength - connection->writeOffset;
+    sqe->buf_index = 0;
+    sqe->user_data = reinterpret_cast<uint64_t>(connection) | WRITE_TAG;
+    connection->writing = true;
+    connection->inflight++;
+
+}
+
+void TLSServer::sent(Loop& loop, Connection *connection, int result) {
+
+    connection->inflight--;
+    connection->writing = false;
+    if (!connection->open) {
+        return;
+    }
+    if (result < 0 && result != -EINTR && result != -EAGAIN) {
+        close(loop, connection);
+        return;
+    }
+
+    if (result > 0) {
+        connection->writeOffset += result;
+    }
+    try {
+        send(loop, connection);
+    }
+    catch (...) {
+        close(loop, connection);
+        return;
+    }
+    if (!connection->writing && connection->closing) {
+        close(loop, connection);
+    }
+
+}
+
+/*
+ * Out of descriptors. The listening socket is level triggered, so a
+ * connection left waiting would wake the loop again at once and spin
+ * it. The spare descriptor is freed, the connection accepted and
+ * closed, and the spare taken back. Returns false if no connection
+ * was waiting or there was no spare.
+ */
+bool TLSServer::shed(Loop& loop) {
+
+    if (loop.sparefd < 0) {
+        return false;
+    }
+    ::close(loop.sparefd);
+    int fd = ::accept4(loop.listenfd, 0, 0, SOCK_CLOEXEC);
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    loop.sparefd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+    return fd >= 0;
+
+}
+
+void TLSServer::setKernelTLS(bool enable) {
+
+    if (running) {
+        throw StateException("Server already started");
+    }
+    kernelTLS = enable;
+
+}
+
+void TLSServer::setMaxConnections(unsigned max) {
+
+    if (running) {
+        throw StateException("Server already started");
+    }
+    if (max == 0 || max > 16000) {
+        throw BadParameterException("Invalid connection limit");
+    }
+    maxConnections = max;
+
+}
+
+void TLSServer::start() {
+
+    if (running) {
+        throw StateException("Server already started");
+    }
+
+    // Without io_uring, or the operations or locked memory it needs,
+    // the io_uring backend falls back to epoll.
+    try {
+        openLoops();
+    }
+    catch (RecordException&) {
+        if (backend != uring_io) {
+            throw;
+        }
+        backend = epoll_io;
+        openLoops();
+    }
+
+    running = true;
+    for (unsigned i = 0; i < loops.size(); ++i) {
+        if (backend == uring_io) {
+            loops[i].thread = std::thread(&TLSServer::runUring, this,
+                                                        std::ref(loops[i]));
+        }
+        else {
+            loops[i].thread = std::thread(&TLSServer::run, this,
+                                                        std::ref(loops[i]));
+        }
+    }
+
+}
+
+void TLSServer::stop() {
+
+    if (!running) {
+        return;
+    }
+
+    for (unsigned i = 0; i < loops.size(); ++i) {
+        uint64_t one = 1;
+        ssize_t count = ::write(loops[i].stopfd, &one, sizeof(one));
+        (void)count;
+    }
+    for (unsigned i = 0; i < loops.size(); ++i) {
+        loops[i].thread.join();
+        closeLoop(loops[i]);
+    }
+    running = false;
+
+}
+
+void TLSServer::submitAccept(Loop& loop) {
+
+    io_uring_sqe *sqe = loop.ring->getSQE();
+    if (sqe == 0) {
+        throw RecordException("io_uring submission queue full");
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = loop.listenfd;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = ACCEPT_TAG;
+
+}
+
+}
+
+#endif  // _TLS_THREAD_LOCAL_
@@ -0,0 +1,186 @@
+#if __cplusplus >= 202002L
+#ifndef _TLS_THREAD_LOCAL_
+
+#include "tls/TLSStream.h"
+#include "tls/AsyncSigner.h"
+#include "tls/exceptions/RecordException.h"
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace CKTLS {
+
+// Static initialization.
+AsyncSigner *TLSStream::signer = 0;
+
+/*
+ * Waits for a signing thread. The coroutine is resumed on the
+ * reactor, not on the signing thread.
+ */
+class SignatureAwaiter {
+
+    public:
+        SignatureAwaiter(Reactor& r, AsyncSigner& s, const coder::ByteArray& d)
+        : reactor(r), signer(s), data(d) {}
+        bool await_ready() const { return false; }
+        void await_suspend(std::coroutine_handle<> h) {
+            signer.submit(data, [this, h](const coder::ByteArray& sig) {
+                signature = sig;
+                reactor.post(h);
+            });
+        }
+        coder::ByteArray await_resume() {
+            if (signature.getLength() == 0) {
+                throw RecordException("ServerKeyExchange signing failed");
+            }
+            return signature;
+        }
+
+    private:
+        Reactor& reactor;
+        AsyncSigner& signer;
+        coder::ByteArray data;
+        coder::ByteArray signature;
+
+};
+
+TLSStream::TLSStream(Reactor& r, int f, ConnectionEnd end)
+: reactor(r),
+  fd(f),
+  connection(end) {
+
+    int flags = ::fcntl(fd, F_GETFL);
+    if (flags < 0 || ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        throw RecordException(std::string("Stream socket setup failed: ")
+                                                    + std::strerror(errno));
+    }
+    if (end == server && signer != 0) {
+        connection.setDeferredSigning(true);
+    }
+
+}
+
+TLSStream::~TLSStream() {
+}
+
+Task<void> TLSStream::close() {
+
+    connection.close();
+    co_await flush();
+
+}
+
+/*
+ * Read what the socket has, waiting for it if there is nothing.
+ */
+Task<void> TLSStream::fill() {
+
+    for (;;) {
+        unsigned available;
+        uint8_t *space = connection.getReadBuffer(available);
+        ssize_t count = ::read(fd, space, available);
+        if (count > 0) {
+            connection.commitRead(count);
+            co_return;
+        }
+        if (count == 0) {
+            throw RecordException("Connection closed by peer");
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            co_await reactor.readable(fd);
+        }
+        else if (errno != EINTR) {
+            throw RecordException(std::string("Stream read failed: ")
+                                                    + std::strerror(errno));
+        }
+    }
+
+}
+
+Task<void> TLSStream::flush() {
+
+    unsigned length;
+    const uint8_t *data = connection.getWriteData(length);
+    while (length > 0) {
+        ssize_t count = ::send(fd, data, length, MSG_NOSIGNAL);
+        if (count >= 0) {
+            connection.written(count);
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            co_await reactor.writable(fd);
+        }
+        else if (errno != EINTR) {
+            throw RecordException(std::string("Stream write failed: ")
+                                                    + std::strerror(errno));
+        }
+        data = connection.getWriteData(length);
+    }
+
+}
+
+Task<void> TLSStream::handshake() {
+
+    for (;;) {
+        switch (connection.handshake()) {
+            case TLSConnection::complete:
+                co_return;
+            case TLSConnection::want_write:
+                co_await flush();
+                break;
+            case TLSConnection::want_read:
+                co_await fill();
+                break;
+            case TLSConnection::want_signature:
+                co_await sign();
+                break;
+            case TLSConnection::closed:
+                throw RecordException("Connection closed during handshake");
+        }
+    }
+
+}
+
+Task<bool> TLSStream::read(RecordView& plaintext) {
+
+    for (;;) {
+        switch (connection.read(plaintext)) {
+            case TLSConnection::complete:
+                co_return true;
+            case TLSConnection::closed:
+                co_return false;
+            default:
+                co_await fill();
+                break;
+        }
+    }
+
+}
+
+void TLSStream::setSigner(AsyncSigner *s) {
+
+    signer = s;
+
+}
+
+Task<void> TLSStream::sign() {
+
+    coder::ByteArray signature = co_await SignatureAwaiter(reactor, *signer,
+                                                connection.getSignatureData());
+    connection.setSignature(signature);
+
+}
+
+Task<void> TLSStream::write(const uint8_t *data, unsigned length) {
+
+    connection.write(data, length);
+    co_await flush();
+
+}
+
+}
+
+#endif  // _TLS_THREAD_LOCAL_
+#endif  // __cplusplus >= 202002L
@@ -0,0 +1,192 @@
+#include "tls/TicketKeyRing.h"
+#include "tls/ConnectionState.h"
+#include "tls/PRF.h"
+#include "tls/exceptions/BadParameterException.h"
+#include <coder/Unsigned16.h>
+#include <coder/Unsigned64.h>
+#include <CryptoKitty-C/cipher/AES.h>
+#include <CryptoKitty-C/ciphermodes/GCM.h>
+#include <CryptoKitty-C/random/FortunaSecureRandom.h>
+#include <CryptoKitty-C/exceptions/BadParameterException.h>
+
+namespace CKTLS {
+
+// Static initialization.
+const unsigned TicketKeyRing::DEFAULT_ROTATION = 3600;
+const unsigned TicketKeyRing::DEFAULT_LIFETIME = 7200;
+const unsigned TicketKeyRing::KEY_NAME_LENGTH = 16;
+
+static const unsigned IV_LENGTH = 12;
+static const unsigned KEY_LENGTH = 32;
+static const unsigned MASTER_SECRET_LENGTH = 48;
+static const unsigned STATE_LENGTH = 2 + 8 + MASTER_SECRET_LENGTH;
+static const unsigned TAG_LENGTH = 16;
+
+/*
+ * One generator is shared by all ring secrets and tickets, so the
+ * generator is seeded once instead of once per ticket.
+ */
+static void nextRandom(coder::ByteArray& bytes) {
+
+    static std::mutex rndLock;
+    static CK::FortunaSecureRandom rnd;
+
+    std::lock_guard<std::mutex> guard(rndLock);
+    rnd.nextBytes(bytes);
+
+}
+
+TicketKeyRing::TicketKeyRing(unsigned rot, unsigned life)
+: secret(32, 0),
+  rotation(rot),
+  lifetime(life) {
+
+    if (rotation == 0 || lifetime == 0) {
+        throw BadParameterException("Invalid ticket key rotation");
+    }
+
+    nextRandom(secret);
+
+}
+
+TicketKeyRing::TicketKeyRing(const coder::ByteArray& s, unsigned rot, unsigned life)
+: secret(s),
+  rotation(rot),
+  lifetime(life) {
+
+    if (rotation == 0 || lifetime == 0) {
+        throw BadParameterException("Invalid ticket key rotation");
+    }
+    if (secret.getLength() < 32) {
+        throw BadParameterException("Ticket key ring secret too short");
+    }
+
+}
+
+TicketKeyRing::~TicketKeyRing() {
+}
+
+bool TicketKeyRing::open(const coder::ByteArray& ticket, Session& session) {
+
+    if (ticket.getLength() != KEY_NAME_LENGTH + IV_LENGTH
+                                            + STATE_LENGTH + TAG_LENGTH) {
+        return false;
+    }
+
+    coder::ByteArray name(ticket.range(0, KEY_NAME_LENGTH));
+    coder::ByteArray key;
+    time_t now = time(0);
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        update(now);
+        for (KeyList::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+            if (it->name == name) {
+                key = it->key;
+            }
+        }
+    }
+    if (key.getLength() == 0) {
+        return false;
+    }
+
+    CK::AES cipher(CK::AES::AES256);
+    CK::GCM gcm(&cipher, ticket.range(KEY_NAME_LENGTH, IV_LENGTH));
+    gcm.setAuthData(name);
+    coder::ByteArray state;
+    try {
+        state = gcm.decrypt(ticket.range(KEY_NAME_LENGTH + IV_LENGTH,
+                                        STATE_LENGTH + TAG_LENGTH), key);
+    }
+    catch (CK::BadParameterException& e) {
+        return false;
+    }
+
+    coder::Unsigned64 created(state.range(2, 8), coder::bigendian);
+    time_t age = now - static_cast<time_t>(created.getValue());
+    if (age < 0 || age >= static_cast<time_t>(lifetime)) {
+        return false;
+    }
+
+    coder::Unsigned16 suite(state.range(0, 2), coder::bigendian);
+    session.suite = static_cast<CipherSuite>(suite.getValue());
+    session.created = static_cast<time_t>(created.getValue());
+    session.masterSecret = state.range(10, MASTER_SECRET_LENGTH);
+    return true;
+
+}
+
+coder::ByteArray TicketKeyRing::seal(const ConnectionState& state) {
+
+    const coder::ByteArray& master(state.getMasterSecret());
+    if (master.getLength() != MASTER_SECRET_LENGTH) {
+        throw BadParameterException("Invalid master secret");
+    }
+
+    time_t now = time(0);
+    coder::ByteArray name;
+    coder::ByteArray key;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        update(now);
+        name = keys.back().name;
+        key = keys.back().key;
+    }
+
+    coder::ByteArray plaintext;
+    coder::Unsigned16 suite(state.getCipherSuite());
+    plaintext.append(suite.getEncoded(coder::bigendian));
+    coder::Unsigned64 created(now);
+    plaintext.append(created.getEncoded(coder::bigendian));
+    plaintext.append(master);
+
+    coder::ByteArray iv(IV_LENGTH, 0);
+    nextRandom(iv);
+    CK::AES cipher(CK::AES::AES256);
+    CK::GCM gcm(&cipher, iv);
+    gcm.setAuthData(name);
+
+    coder::ByteArray ticket(name);
+    ticket.append(iv);
+    ticket.append(gcm.encrypt(plaintext, key));
+    return ticket;
+
+}
+
+/*
+ * Derive the keys for the current interval and for as many earlier
+ * intervals as a ticket can outlive, and drop the rest. The caller
+ * holds the lock.
+ */
+void TicketKeyRing::update(time_t now) {
+
+    uint64_t current = static_cast<uint64_t>(now) / rotation;
+    if (keys.size() > 0 && keys.back().interval == current) {
+        return;
+    }
+
+    uint64_t window = (lifetime + rotation - 1) / rotation;
+    uint64_t first = current > window ? current - window : 0;
+    while (keys.size() > 0 && keys.front().interval < first) {
+        keys.pop_front();
+    }
+    if (keys.size() > 0 && keys.back().interval >= first) {
+        first = keys.back().interval + 1;
+    }
+
+    PRF prf(tls_prf_sha256);
+    prf.setSecret(secret);
+    uint8_t block[KEY_NAME_LENGTH + KEY_LENGTH];
+    for (uint64_t interval = first; interval <= current; ++interval) {
+        coder::Unsigned64 seed(interval);
+        prf.generate("ticket key", seed.getEncoded(coder::bigendian),
+                                                    block, sizeof(block));
+        TicketKey tk;
+        tk.interval = interval;
+        tk.name.append(block, KEY_NAME_LENGTH);
+        tk.key.append(block + KEY_NAME_LENGTH, KEY_LENGTH);
+        keys.push_back(tk);
+    }
+
+}
+
+}
@@ -0,0 +1,708 @@
+/*
+ * Full handshake benchmark. Runs complete client and server
+ * handshakes through the handshake message classes over a loopback
+ * socket pair and reports handshakes/s on one core, p50/p99 latency
+ * and the time spent in each handshake message. Abbreviated
+ * handshakes resume the sessions the full handshakes cached, by
+ * session ID and by session ticket. After the warm up, when the
+ * client has cached the server certificate, the server sends only
+ * the certificate fingerprint.
+ */
+#include "tls/HandshakeRecord.h"
+#include "tls/ClientHello.h"
+#include "tls/ServerHello.h"
+#include "tls/ServerCertificate.h"
+#include "tls/ServerKeyExchange.h"
+#include "tls/ClientKeyExchange.h"
+#include "tls/ChangeCipherSpec.h"
+#include "tls/CipherText.h"
+#include "tls/Finished.h"
+#include "tls/NewSessionTicket.h"
+#include "tls/ConnectionState.h"
+#include "tls/CipherSuiteManager.h"
+#include "tls/CertificateCache.h"
+#include "tls/DHGroup.h"
+#include "tls/DHKeyPool.h"
+#include "tls/ECDHKeyPool.h"
+#include "tls/RecordReader.h"
+#include "tls/RecordBatch.h"
+#include "tls/SessionCache.h"
+#include "tls/TicketKeyRing.h"
+#include "tls/exceptions/RecordException.h"
+#include <CryptoKitty-C/keys/RSAKeyPairGenerator.h>
+#include <CryptoKitty-C/random/FortunaSecureRandom.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef _TLS_THREAD_LOCAL_
+#error "The handshake benchmark requires StateContainer connection states"
+#endif
+
+namespace {
+
+enum Step { CLIENT_HELLO, SERVER_HELLO, CERTIFICATE, SERVER_KEY_EXCHANGE,
+            SERVER_HELLO_DONE, CLIENT_KEY_EXCHANGE, KEY_DERIVATION,
+            NEW_SESSION_TICKET, CHANGE_CIPHER_SPEC, FINISHED, STEP_COUNT };
+
+const char *stepNames[STEP_COUNT] = { "ClientHello", "ServerHello",
+            "Certificate", "ServerKeyExchange", "ServerHelloDone",
+            "ClientKeyExchange", "Key derivation", "NewSessionTicket",
+            "ChangeCipherSpec", "Finished" };
+
+typedef std::chrono::steady_clock Clock;
+
+double stepTimes[STEP_COUNT];
+
+void elapsed(Step step, const Clock::time_point& start) {
+
+    stepTimes[step] += std::chrono::duration<double>(Clock::now() - start).count();
+
+}
+
+CKTLS::PGPCertificate *serverCert;
+CKTLS::CertificateCache clientCertificates;
+bool sendFingerprint = false;
+CKTLS::SessionCache sessionCache;
+CKTLS::TicketKeyRing ticketKeys;
+CKTLS::ECDHKeyPool *ecdhPool;
+CKTLS::DHKeyPool *dhPool;
+
+/*
+ * The client's copy of a resumable session.
+ */
+struct ClientSession {
+    coder::ByteArray id;
+    coder::ByteArray masterSecret;
+    coder::ByteArray ticket;
+};
+
+/*
+ * Empty SessionTicket extension. Offers ticket support in a
+ * ClientHello and accepts it in a ServerHello.
+ */
+CKTLS::Extension ticketExtension(const coder::ByteArray& ticket) {
+
+    CKTLS::Extension ext;
+    ext.type.setValue(CKTLS::ExtensionManager::SESSION_TICKET);
+    ext.data = ticket;
+    return ext;
+
+}
+
+/*
+ * One end of the loopback connection.
+ */
+struct Endpoint {
+    Endpoint(CKTLS::ConnectionEnd end, int f)
+    : fd(f) {
+        holder.getPendingRead()->setEntity(end);
+        holder.getPendingWrite()->setEntity(end);
+    }
+    CKTLS::StateContainer holder;
+    CKTLS::RecordReader reader;
+    CKTLS::RecordBatch batch;
+    int fd;
+    coder::ByteArray transcript;    // Handshake messages so far.
+};
+
+void flush(Endpoint& from) {
+
+    while (!from.batch.flush(from.fd)) {
+    }
+
+}
+
+void send(Endpoint& from, CKTLS::RecordProtocol& record, Step step) {
+
+    Clock::time_point t = Clock::now();
+    from.batch.append(record);
+    if (record.getRecordType() == CKTLS::handshake) {
+        from.transcript.append(record.getFragment());
+    }
+    elapsed(step, t);
+
+}
+
+/*
+ * Finished is sent under the new keys, as TLSConnection sends it.
+ */
+void sendFinished(Endpoint& from, CKTLS::HandshakeRecord& fin) {
+
+    Clock::time_point t = Clock::now();
+    fin.encodeRecord();
+    from.transcript.append(fin.getFragment());
+    CKTLS::CipherText record(&from.holder, CKTLS::handshake);
+    record.setPlaintext(fin.getFragment());
+    from.batch.append(record);
+    from.holder.getCurrentRead()->incrementSequence();
+    elapsed(FINISHED, t);
+
+}
+
+void nextRecord(Endpoint& to, CKTLS::RecordView& view) {
+
+    while (!to.reader.nextRecord(view)) {
+        unsigned available;
+        uint8_t *space = to.reader.getReadBuffer(available);
+        ssize_t count = ::read(to.fd, space, available);
+        if (count <= 0) {
+            throw CKTLS::RecordException("Loopback read failed");
+        }
+        to.reader.commit(count);
+    }
+
+}
+
+void receive(Endpoint& to, CKTLS::RecordProtocol& record, Step step) {
+
+    CKTLS::RecordView view;
+    nextRecord(to, view);
+
+    Clock::time_point t = Clock::now();
+    coder::ByteArray header;
+    header.append(view.data, 5);
+    record.decodePreamble(header);
+    coder::ByteArray fragment;
+    fragment.append(view.data + 5, view.length - 5);
+    record.setFragment(fragment);
+    record.decodeRecord();
+    if (record.getRecordType() == CKTLS::handshake) {
+        to.transcript.append(fragment);
+    }
+    elapsed(step, t);
+
+}
+
+void receiveFinished(Endpoint& to, CKTLS::HandshakeRecord& fin) {
+
+    CKTLS::RecordView view;
+    nextRecord(to, view);
+
+    Clock::time_point t = Clock::now();
+    CKTLS::CipherText record(&to.holder, CKTLS::handshake);
+    CKTLS::RecordView opened = record.decodeInPlace(view.data, view.length);
+    to.holder.getCurrentWrite()->incrementSequence();
+    coder::ByteArray fragment;
+    fragment.append(opened.data, opened.length);
+    fin.setFragment(fragment);
+    fin.decodeRecord();
+    to.transcript.append(fragment);
+    elapsed(FINISHED, t);
+
+}
+
+/*
+ * Set the negotiated security parameters on a pending state.
+ */
+void negotiate(CKTLS::ConnectionState *state, CKTLS::CipherSuite suite,
+            const coder::ByteArray& clientRandom, const coder::ByteArray& serverRandom) {
+
+    state->setCipherSuite(suite);
+    state->setClientRandom(clientRandom);
+    state->setServerRandom(serverRandom);
+
+}
+
+void deriveKeys(Endpoint& end, const coder::ByteArray& premasterSecret) {
+
+    Clock::time_point t = Clock::now();
+    end.holder.getPendingRead()->generateKeys(premasterSecret);
+    end.holder.getPendingRead()->setInitialized();
+    end.holder.getPendingWrite()->generateKeys(premasterSecret);
+    end.holder.getPendingWrite()->setInitialized();
+    elapsed(KEY_DERIVATION, t);
+
+}
+
+void resumeKeys(Endpoint& end, const coder::ByteArray& masterSecret) {
+
+    Clock::time_point t = Clock::now();
+    end.holder.getPendingRead()->resumeKeys(masterSecret);
+    end.holder.getPendingRead()->setInitialized();
+    end.holder.getPendingWrite()->resumeKeys(masterSecret);
+    end.holder.getPendingWrite()->setInitialized();
+    elapsed(KEY_DERIVATION, t);
+
+}
+
+/*
+ * Run one complete handshake and cache the session. Returns the
+ * elapsed seconds.
+ */
+double handshake(CKTLS::KeyExchangeAlgorithm kx, int fds[2], ClientSession& session) {
+
+    Clock::time_point begin = Clock::now();
+    Endpoint client(CKTLS::client, fds[0]);
+    Endpoint server(CKTLS::server, fds[1]);
+    CK::FortunaSecureRandom rnd;
+
+    // Client flight 1.
+    CKTLS::HandshakeRecord clientHello(CKTLS::client_hello, &client.holder);
+    dynamic_cast<CKTLS::ClientHello*>(clientHello.getBody())
+                            ->addExtension(ticketExtension(coder::ByteArray()));
+    send(client, clientHello, CLIENT_HELLO);
+    flush(client);
+
+    // Server flight 1.
+    CKTLS::HandshakeRecord helloIn(&server.holder);
+    receive(server, helloIn, CLIENT_HELLO);
+    CKTLS::ClientHello *ch = dynamic_cast<CKTLS::ClientHello*>(helloIn.getBody());
+
+    Clock::time_point t = Clock::now();
+    CKTLS::HandshakeRecord serverHello(CKTLS::server_hello, &server.holder);
+    CKTLS::ServerHello *sh = dynamic_cast<CKTLS::ServerHello*>(serverHello.getBody());
+    sh->initState(*ch);
+    sh->setSessionID(CKTLS::SessionCache::newSessionID());
+    CKTLS::Extension ext;
+    bool issueTicket = ch->getExtension(CKTLS::ExtensionManager::SESSION_TICKET, ext);
+    if (issueTicket) {
+        sh->addExtension(ticketExtension(coder::ByteArray()));
+    }
+    negotiate(server.holder.getPendingRead(), sh->getCipherSuite(),
+                                        ch->getRandom(), sh->getRandom());
+    negotiate(server.holder.getPendingWrite(), sh->getCipherSuite(),
+                                        ch->getRandom(), sh->getRandom());
+    elapsed(SERVER_HELLO, t);
+    send(server, serverHello, SERVER_HELLO);
+
+    t = Clock::now();
+    CKTLS::HandshakeRecord certificate(CKTLS::certificate, &server.holder);
+    CKTLS::ServerCertificate *sc =
+                dynamic_cast<CKTLS::ServerCertificate*>(certificate.getBody());
+    if (sendFingerprint) {
+        sc->setDescriptorType(CKTLS::ServerCertificate::subkey_cert_fingerprint);
+    }
+    sc->setCertificate(serverCert);
+    sc->setKeyID(0);
+    elapsed(CERTIFICATE, t);
+    send(server, certificate, CERTIFICATE);
+
+    t = Clock::now();
+    CK::BigInteger serverSecret;
+    CK::ECDHKeyExchange *serverECDH = 0;
+    CKTLS::HandshakeRecord keyExchange(CKTLS::server_key_exchange, &server.holder);
+    CKTLS::ServerKeyExchange *ske =
+                dynamic_cast<CKTLS::ServerKeyExchange*>(keyExchange.getBody());
+    if (kx == CKTLS::dhe_rsa) {
+        CKTLS::DHKey key(dhPool->pop());
+        serverSecret = key.secret;
+        ske->initState(dhPool->getGroup(), key.publicKey);
+    }
+    else {
+        CKTLS::ECDHKey key(ecdhPool->pop(CKTLS::secp256r1));
+        serverECDH = key.exchange;
+        ske->initState(CKTLS::secp256r1, key.publicKey);
+    }
+    elapsed(SERVER_KEY_EXCHANGE, t);
+    send(server, keyExchange, SERVER_KEY_EXCHANGE);
+
+    CKTLS::HandshakeRecord helloDone(CKTLS::server_hello_done, &server.holder);
+    send(server, helloDone, SERVER_HELLO_DONE);
+    flush(server);
+
+    // Client flight 2.
+    CKTLS::HandshakeRecord serverHelloIn(&client.holder);
+    receive(client, serverHelloIn, SERVER_HELLO);
+    CKTLS::ServerHello *shIn =
+                dynamic_cast<CKTLS::ServerHello*>(serverHelloIn.getBody());
+    CKTLS::ClientHello *chOut =
+                dynamic_cast<CKTLS::ClientHello*>(clientHello.getBody());
+    t = Clock::now();
+    negotiate(client.holder.getPendingRead(), shIn->getCipherSuite(),
+                                        chOut->getRandom(), shIn->getRandom());
+    negotiate(client.holder.getPendingWrite(), shIn->getCipherSuite(),
+                                        chOut->getRandom(), shIn->getRandom());
+    elapsed(SERVER_HELLO, t);
+
+    CKTLS::HandshakeRecord certificateIn(&client.holder);
+    receive(client, certificateIn, CERTIFICATE);
+    CKTLS::HandshakeRecord keyExchangeIn(&client.holder);
+    receive(client, keyExchangeIn, SERVER_KEY_EXCHANGE);
+    CKTLS::ServerKeyExchange *skeIn =
+                dynamic_cast<CKTLS::ServerKeyExchange*>(keyExchangeIn.getBody());
+    t = Clock::now();
+    CKTLS::ServerCertificate *scIn =
+            dynamic_cast<CKTLS::ServerCertificate*>(certificateIn.getBody());
+    skeIn->verify(*scIn->getReceived()->getPublicKey()->getRSAPublicKey());
+    elapsed(SERVER_KEY_EXCHANGE, t);
+    CKTLS::HandshakeRecord helloDoneIn(&client.holder);
+    receive(client, helloDoneIn, SERVER_HELLO_DONE);
+
+    t = Clock::now();
+    coder::ByteArray clientPremaster;
+    CKTLS::HandshakeRecord clientKeyExchange(CKTLS::client_key_exchange, &client.holder);
+    CKTLS::ClientKeyExchange *cke =
+            dynamic_cast<CKTLS::ClientKeyExchange*>(clientKeyExchange.getBody());
+    if (kx == CKTLS::dhe_rsa) {
+        CK::BigInteger clientSecret(256, rnd);
+        const CK::BigInteger& p(skeIn->getDHModulus());
+        cke->initState(skeIn->getDHGenerator().modPow(clientSecret, p));
+        clientPremaster = skeIn->getDHPublicKey().modPow(clientSecret, p)
+                                        .getEncoded(CK::BigInteger::BIGENDIAN);
+    }
+    else {
+        CK::ECDHKeyExchange clientECDH(skeIn->getCurve());
+        cke->initState(CKTLS::secp256r1, clientECDH.getPublicKey());
+        clientPremaster = clientECDH.getSecret(skeIn->getECPublicKey());
+    }
+    elapsed(CLIENT_KEY_EXCHANGE, t);
+    send(client, clientKeyExchange, CLIENT_KEY_EXCHANGE);
+    deriveKeys(client, clientPremaster);
+
+    CKTLS::ChangeCipherSpec clientCCS(&client.holder);
+    send(client, clientCCS, CHANGE_CIPHER_SPEC);
+    client.holder.getPendingRead()->promoteRead(&client.holder);
+
+    CKTLS::HandshakeRecord clientFinished(CKTLS::finished, &client.holder);
+    dynamic_cast<CKTLS::Finished*>(clientFinished.getBody())->initState(client.transcript);
+    sendFinished(client, clientFinished);
+    flush(client);
+
+    // Server flight 2.
+    CKTLS::HandshakeRecord clientKeyExchangeIn(&server.holder);
+    receive(server, clientKeyExchangeIn, CLIENT_KEY_EXCHANGE);
+    CKTLS::ClientKeyExchange *ckeIn =
+            dynamic_cast<CKTLS::ClientKeyExchange*>(clientKeyExchangeIn.getBody());
+    t = Clock::now();
+    coder::ByteArray serverPremaster;
+    if (kx == CKTLS::dhe_rsa) {
+        serverPremaster = ckeIn->getDHPublicKey().modPow(serverSecret,
+                                                dhPool->getGroup().getModulus())
+                                        .getEncoded(CK::BigInteger::BIGENDIAN);
+    }
+    else {
+        serverPremaster = serverECDH->getSecret(ckeIn->getECPublicKey());
+        delete serverECDH;
+    }
+    elapsed(CLIENT_KEY_EXCHANGE, t);
+    deriveKeys(server, serverPremaster);
+
+    CKTLS::ChangeCipherSpec clientCCSIn(&server.holder);
+    receive(server, clientCCSIn, CHANGE_CIPHER_SPEC);
+    server.holder.getPendingWrite()->promoteWrite(&server.holder);
+
+    coder::ByteArray serverExpected(server.transcript);
+    CKTLS::HandshakeRecord clientFinishedIn(&server.holder);
+    receiveFinished(server, clientFinishedIn);
+    t = Clock::now();
+    if (!dynamic_cast<CKTLS::Finished*>(clientFinishedIn.getBody())
+                                            ->authenticate(serverExpected)) {
+        throw CKTLS::RecordException("Client Finished not authenticated");
+    }
+    elapsed(FINISHED, t);
+
+    CKTLS::HandshakeRecord newTicket(CKTLS::new_session_ticket, &server.holder);
+    if (issueTicket) {
+        t = Clock::now();
+        dynamic_cast<CKTLS::NewSessionTicket*>(newTicket.getBody())->initState(
+                ticketKeys.getLifetime(), ticketKeys.seal(*server.holder.getCurrentWrite()));
+        elapsed(NEW_SESSION_TICKET, t);
+        send(server, newTicket, NEW_SESSION_TICKET);
+    }
+
+    CKTLS::ChangeCipherSpec serverCCS(&server.holder);
+    send(server, serverCCS, CHANGE_CIPHER_SPEC);
+    server.holder.getPendingRead()->promoteRead(&server.holder);
+
+    CKTLS::HandshakeRecord serverFinished(CKTLS::finished, &server.holder);
+    dynamic_cast<CKTLS::Finished*>(serverFinished.getBody())->initState(server.transcript);
+    sendFinished(server, serverFinished);
+    flush(server);
+    sessionCache.store(sh->getSessionID(), *server.holder.getCurrentWrite());
+
+    // Client completion.
+    session.ticket.clear();
+    if (shIn->getExtension(CKTLS::ExtensionManager::SESSION_TICKET, ext)) {
+        CKTLS::HandshakeRecord newTicketIn(&client.holder);
+        receive(client, newTicketIn, NEW_SESSION_TICKET);
+        session.ticket = dynamic_cast<CKTLS::NewSessionTicket*>(newTicketIn.getBody())
+                                                                ->getTicket();
+    }
+
+    CKTLS::ChangeCipherSpec serverCCSIn(&client.holder);
+    receive(client, serverCCSIn, CHANGE_CIPHER_SPEC);
+    client.holder.getPendingWrite()->promoteWrite(&client.holder);
+
+    coder::ByteArray clientExpected(client.transcript);
+    CKTLS::HandshakeRecord serverFinishedIn(&client.holder);
+    receiveFinished(client, serverFinishedIn);
+    t = Clock::now();
+    if (!dynamic_cast<CKTLS::Finished*>(serverFinishedIn.getBody())
+                                            ->authenticate(clientExpected)) {
+        throw CKTLS::RecordException("Server Finished not authenticated");
+    }
+    elapsed(FINISHED, t);
+    session.id = shIn->getSessionID();
+    session.masterSecret = client.holder.getCurrentRead()->getMasterSecret();
+
+    return std::chrono::duration<double>(Clock::now() - begin).count();
+
+}
+
+/*
+ * Run one abbreviated handshake. See RFC 5246 Section 7.3. The
+ * server sends its ChangeCipherSpec and Finished right after the
+ * ServerHello. With a ticket, the client sends a new session ID
+ * that the server echoes to accept the ticket. See RFC 5077
+ * Section 3.4. Returns the elapsed seconds.
+ */
+double resume(int fds[2], const ClientSession& session, bool useTicket) {
+
+    Clock::time_point begin = Clock::now();
+    Endpoint client(CKTLS::client, fds[0]);
+    Endpoint server(CKTLS::server, fds[1]);
+
+    // Client flight 1.
+    Clock::time_point t = Clock::now();
+    CKTLS::HandshakeRecord clientHello(CKTLS::client_hello, &client.holder);
+    CKTLS::ClientHello *chOut =
+                dynamic_cast<CKTLS::ClientHello*>(clientHello.getBody());
+    if (useTicket) {
+        chOut->setSessionID(CKTLS::SessionCache::newSessionID());
+        chOut->addExtension(ticketExtension(session.ticket));
+    }
+    else {
+        chOut->setSessionID(session.id);
+    }
+    elapsed(CLIENT_HELLO, t);
+    send(client, clientHello, CLIENT_HELLO);
+    flush(client);
+
+    // Server flight 1.
+    CKTLS::HandshakeRecord helloIn(&server.holder);
+    receive(server, helloIn, CLIENT_HELLO);
+    CKTLS::ClientHello *ch = dynamic_cast<CKTLS::ClientHello*>(helloIn.getBody());
+
+    t = Clock::now();
+    CKTLS::Session cached;
+    CKTLS::Extension ext;
+    if (useTicket) {
+        if (!ch->getExtension(CKTLS::ExtensionManager::SESSION_TICKET, ext)
+                                        || !ticketKeys.open(ext.data, cached)) {
+            throw CKTLS::RecordException("Session ticket not accepted");
+        }
+    }
+    else if (!sessionCache.find(ch->getSessionID(), cached)) {
+        throw CKTLS::RecordException("Session not cached");
+    }
+    CKTLS::HandshakeRecord serverHello(CKTLS::server_hello, &server.holder);
+    CKTLS::ServerHello *sh = dynamic_cast<CKTLS::ServerHello*>(serverHello.getBody());
+    sh->initState(*ch);
+    if (sh->getCipherSuite() != cached.suite) {
+        throw CKTLS::RecordException("Cached cipher suite not offered");
+    }
+    sh->setSessionID(ch->getSessionID());
+    negotiate(server.holder.getPendingRead(), cached.suite,
+                                        ch->getRandom(), sh->getRandom());
+    negotiate(server.holder.getPendingWrite(), cached.suite,
+                                        ch->getRandom(), sh->getRandom());
+    elapsed(SERVER_HELLO, t);
+    send(server, serverHello, SERVER_HELLO);
+    resumeKeys(server, cached.masterSecret);
+
+    CKTLS::ChangeCipherSpec serverCCS(&server.holder);
+    send(server, serverCCS, CHANGE_CIPHER_SPEC);
+    server.holder.getPendingRead()->promoteRead(&server.holder);
+
+    CKTLS::HandshakeRecord serverFinished(CKTLS::finished, &server.holder);
+    dynamic_cast<CKTLS::Finished*>(serverFinished.getBody())->initState(server.transcript);
+    sendFinished(server, serverFinished);
+    flush(server);
+
+    // Client flight 2.
+    CKTLS::HandshakeRecord serverHelloIn(&client.holder);
+    receive(client, serverHelloIn, SERVER_HELLO);
+    CKTLS::ServerHello *shIn =
+                dynamic_cast<CKTLS::ServerHello*>(serverHelloIn.getBody());
+    t = Clock::now();
+    if (!(shIn->getSessionID() == chOut->getSessionID())) {
+        throw CKTLS::RecordException("Session not resumed");
+    }
+    negotiate(client.holder.getPendingRead(), shIn->getCipherSuite(),
+                                        chOut->getRandom(), shIn->getRandom());
+    negotiate(client.holder.getPendingWrite(), shIn->getCipherSuite(),
+                                        chOut->getRandom(), shIn->getRandom());
+    elapsed(SERVER_HELLO, t);
+    resumeKeys(client, session.masterSecret);
+
+    CKTLS::ChangeCipherSpec serverCCSIn(&client.holder);
+    receive(client, serverCCSIn, CHANGE_CIPHER_SPEC);
+    client.holder.getPendingWrite()->promoteWrite(&client.holder);
+
+    coder::ByteArray clientExpected(client.transcript);
+    CKTLS::HandshakeRecord serverFinishedIn(&client.holder);
+    receiveFinished(client, serverFinishedIn);
+    t = Clock::now();
+    if (!dynamic_cast<CKTLS::Finished*>(serverFinishedIn.getBody())
+                                            ->authenticate(clientExpected)) {
+        throw CKTLS::RecordException("Server Finished not authenticated");
+    }
+    elapsed(FINISHED, t);
+
+    CKTLS::ChangeCipherSpec clientCCS(&client.holder);
+    send(client, clientCCS, CHANGE_CIPHER_SPEC);
+    client.holder.getPendingRead()->promoteRead(&client.holder);
+
+    CKTLS::HandshakeRecord clientFinished(CKTLS::finished, &client.holder);
+    dynamic_cast<CKTLS::Finished*>(clientFinished.getBody())->initState(client.transcript);
+    sendFinished(client, clientFinished);
+    flush(client);
+
+    // Server completion.
+    CKTLS::ChangeCipherSpec clientCCSIn(&server.holder);
+    receive(server, clientCCSIn, CHANGE_CIPHER_SPEC);
+    server.holder.getPendingWrite()->promoteWrite(&server.holder);
+
+    coder::ByteArray serverExpected(server.transcript);
+    CKTLS::HandshakeRecord clientFinishedIn(&server.holder);
+    receiveFinished(server, clientFinishedIn);
+    t = Clock::now();
+    if (!dynamic_cast<CKTLS::Finished*>(clientFinishedIn.getBody())
+                                            ->authenticate(serverExpected)) {
+        throw CKTLS::RecordException("Client Finished not authenticated");
+    }
+    elapsed(FINISHED, t);
+
+    return std::chrono::duration<double>(Clock::now() - begin).count();
+
+}
+
+/*
+ * Create the server identity. The certificate carries a freshly
+ * generated RSA key so that the client can verify the
+ * ServerKeyExchange signature.
+ */
+void createIdentity() {
+
+    CK::RSAKeyPairGenerator gen;
+    gen.setKeySize(2048);
+    CK::KeyPair<CK::RSAPublicKey, CK::RSAPrivateKey> *pair = gen.generateKeyPair();
+    CKTLS::ServerCertificate::setRSAPrivateKey(pair->privateKey());
+
+    serverCert = new CKTLS::PGPCertificate;
+    serverCert->setPublicKey(new CKPGP::PublicKey(pair->publicKey()));
+    serverCert->addUserID(CKPGP::UserID("CryptoKitty-TLS benchmark"),
+                                                        CKPGP::Signature());
+
+}
+
+void report(const char *name, std::vector<double>& latencies, double total) {
+
+    unsigned count = latencies.size();
+    std::sort(latencies.begin(), latencies.end());
+    double p50 = latencies[latencies.size() / 2];
+    double p99 = latencies[(latencies.size() * 99) / 100];
+
+    std::cout << name << ": " << count << " handshakes" << std::endl;
+    std::cout << std::fixed << std::setprecision(1)
+              << "  " << count / total << " handshakes/s/core" << std::endl
+              << std::setprecision(3)
+              << "  p50 " << p50 * 1000 << " ms, p99 " << p99 * 1000
+              << " ms" << std::endl;
+    double measured = 0;
+    for (unsigned s = 0; s < STEP_COUNT; ++s) {
+        measured += stepTimes[s];
+    }
+    for (unsigned s = 0; s < STEP_COUNT; ++s) {
+        std::cout << "  " << std::left << std::setw(20) << stepNames[s]
+                  << std::right << std::setw(10) << (stepTimes[s] / count) * 1000
+                  << " ms" << std::setw(8) << std::setprecision(1)
+                  << (stepTimes[s] / measured) * 100 << " %"
+                  << std::setprecision(3) << std::endl;
+    }
+
+}
+
+/*
+ * Run full handshakes, then abbreviated handshakes resuming the
+ * sessions the full handshakes cached.
+ */
+void run(CKTLS::KeyExchangeAlgorithm kx, CKTLS::CipherSuite suite,
+                                        const char *name, unsigned count) {
+
+    CKTLS::CipherSuiteList preferred;
+    preferred.push_back(suite);
+    CKTLS::CipherSuiteManager::setServerPreferred(preferred);
+
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        std::cerr << "socketpair: " << std::strerror(errno) << std::endl;
+        std::exit(1);
+    }
+
+    // Warm up.
+    std::vector<ClientSession> sessions(count);
+    for (unsigned i = 0; i < 4; ++i) {
+        handshake(kx, fds, sessions[0]);
+        resume(fds, sessions[0], false);
+        resume(fds, sessions[0], true);
+    }
+    sendFingerprint = true;
+
+    std::fill(stepTimes, stepTimes + STEP_COUNT, 0.0);
+    std::vector<double> latencies;
+    double total = 0;
+    for (unsigned i = 0; i < count; ++i) {
+        double seconds = handshake(kx, fds, sessions[i]);
+        latencies.push_back(seconds);
+        total += seconds;
+    }
+    report(name, latencies, total);
+
+    for (unsigned mode = 0; mode < 2; ++mode) {
+        std::fill(stepTimes, stepTimes + STEP_COUNT, 0.0);
+        latencies.clear();
+        total = 0;
+        for (unsigned i = 0; i < count; ++i) {
+            double seconds = resume(fds, sessions[i], mode == 1);
+            latencies.push_back(seconds);
+            total += seconds;
+        }
+        std::string resumed(name);
+        resumed += mode == 1 ? " ticket resumed" : " resumed";
+        report(resumed.c_str(), latencies, total);
+    }
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+
+}
+
+}
+
+int main(int argc, char *argv[]) {
+
+    unsigned count = 200;
+    if (argc > 1) {
+        count = std::strtoul(argv[1], 0, 10);
+    }
+    if (count == 0) {
+        count = 1;
+    }
+
+    createIdentity();
+    CKTLS::ServerCertificate::setCertificateCache(&clientCertificates);
+    ecdhPool = new CKTLS::ECDHKeyPool;
+    dhPool = new CKTLS::DHKeyPool(CKTLS::DHGroup::ffdhe2048());
+
+    run(CKTLS::dhe_rsa, CKTLS::TLS_DHE_RSA_WITH_AES_128_GCM_SHA256,
+                                                "dhe_rsa", count);
+    run(CKTLS::ec_diffie_hellman, CKTLS::TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+                                                "ec_diffie_hellman", count);
+    std::cout << "DH key pool misses: " << dhPool->getMisses() << std::endl;
+    std::cout << "ECDH key pool misses: " << ecdhPool->getMisses() << std::endl;
+    delete dhPool;
+    delete ecdhPool;
+
+    return 0;
+
+}
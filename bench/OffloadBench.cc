@@ -0,0 +1,333 @@
+/*
+ * Kernel TLS offload check and benchmark. Runs TLSConnection client
+ * and server handshakes over TCP loopback, since the kernel attaches
+ * TLS only to TCP sockets, then hands the server's transmit side to
+ * the kernel with offload(). The client decrypts everything the kernel
+ * sent, written data, a sendfile() and the close_notify, and checks
+ * it. The same transfer through CipherText gives the comparison.
+ *
+ * Kernels without the tls module refuse TCP_ULP with ENOENT. The
+ * kernel runs are then skipped with a note and only the user space
+ * runs are reported.
+ */
+#include "tls/TLSConnection.h"
+#include "tls/CipherSuiteManager.h"
+#include "tls/PGPCertificate.h"
+#include "tls/ServerCertificate.h"
+#include "tls/ServerKeyExchange.h"
+#include "tls/exceptions/RecordException.h"
+#include <CryptoKitty-C/keys/RSAKeyPairGenerator.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef _TLS_THREAD_LOCAL_
+#error "The offload benchmark requires StateContainer connection states"
+#endif
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const unsigned CHUNK = 64 * 1024;
+const unsigned FILE_LENGTH = 1024 * 1024;
+
+/*
+ * The transfer is a repeating pattern so the client can check every
+ * byte wherever the records split it.
+ */
+uint8_t pattern(uint64_t offset) {
+
+    return offset % 251;
+
+}
+
+void fail(const std::string& what) {
+
+    std::cerr << what << std::endl;
+    std::exit(1);
+
+}
+
+/*
+ * True unless the kernel has no tls module. An unconnected socket
+ * fails with ENOTCONN once the module is found.
+ */
+bool kernelTLSLoaded() {
+
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        fail(std::string("socket: ") + std::strerror(errno));
+    }
+    bool loaded = ::setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) == 0
+                                                        || errno != ENOENT;
+    ::close(fd);
+    return loaded;
+
+}
+
+/*
+ * Connected TCP loopback sockets. fds[0] is the client's.
+ */
+void loopback(int fds[2]) {
+
+    int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(addr);
+    if (listener < 0
+            || ::bind(listener, reinterpret_cast<sockaddr*>(&addr), length) != 0
+            || ::listen(listener, 1) != 0
+            || ::getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &length) != 0) {
+        fail(std::string("Loopback listener: ") + std::strerror(errno));
+    }
+    fds[0] = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fds[0] < 0
+            || ::connect(fds[0], reinterpret_cast<sockaddr*>(&addr), length) != 0) {
+        fail(std::string("Loopback connect: ") + std::strerror(errno));
+    }
+    fds[1] = ::accept(listener, 0, 0);
+    if (fds[1] < 0) {
+        fail(std::string("Loopback accept: ") + std::strerror(errno));
+    }
+    ::close(listener);
+
+}
+
+void fill(CKTLS::TLSConnection& connection, int fd) {
+
+    unsigned available;
+    uint8_t *space = connection.getReadBuffer(available);
+    ssize_t count = ::read(fd, space, available);
+    if (count <= 0) {
+        throw CKTLS::RecordException("Loopback read failed");
+    }
+    connection.commitRead(count);
+
+}
+
+void flush(CKTLS::TLSConnection& connection, int fd) {
+
+    while (!connection.flush(fd)) {
+    }
+
+}
+
+void handshake(CKTLS::TLSConnection& connection, int fd) {
+
+    for (;;) {
+        switch (connection.handshake()) {
+            case CKTLS::TLSConnection::complete:
+                return;
+            case CKTLS::TLSConnection::want_write:
+                flush(connection, fd);
+                break;
+            case CKTLS::TLSConnection::want_read:
+                fill(connection, fd);
+                break;
+            case CKTLS::TLSConnection::want_signature:
+                connection.setSignature(CKTLS::ServerKeyExchange::sign(
+                                            connection.getSignatureData()));
+                break;
+            case CKTLS::TLSConnection::closed:
+                throw CKTLS::RecordException("Closed during handshake");
+        }
+    }
+
+}
+
+/*
+ * Client end. Reads until the close_notify and checks the bytes.
+ */
+void receive(int fd, uint64_t expected, bool& ok) {
+
+    ok = false;
+    try {
+        CKTLS::TLSConnection connection(CKTLS::client);
+        handshake(connection, fd);
+        uint64_t offset = 0;
+        CKTLS::RecordView view;
+        for (;;) {
+            CKTLS::TLSConnection::Status status = connection.read(view);
+            if (status == CKTLS::TLSConnection::closed) {
+                break;
+            }
+            if (status != CKTLS::TLSConnection::complete) {
+                fill(connection, fd);
+                continue;
+            }
+            for (unsigned i = 0; i < view.length; ++i) {
+                if (view.data[i] != pattern(offset + i)) {
+                    std::cerr << "Data mismatch at " << offset + i << std::endl;
+                    return;
+                }
+            }
+            offset += view.length;
+        }
+        if (offset != expected) {
+            std::cerr << "Received " << offset << " of " << expected
+                      << " bytes" << std::endl;
+            return;
+        }
+        ok = true;
+    }
+    catch (CKTLS::RecordException& e) {
+        std::cerr << "Client: " << e.what() << std::endl;
+    }
+
+}
+
+/*
+ * Send the file part of the transfer. The kernel protects it.
+ */
+void sendFile(int fd, uint64_t start) {
+
+    std::FILE *file = std::tmpfile();
+    if (file == 0) {
+        fail(std::string("tmpfile: ") + std::strerror(errno));
+    }
+    std::vector<uint8_t> data(FILE_LENGTH);
+    for (unsigned i = 0; i < FILE_LENGTH; ++i) {
+        data[i] = pattern(start + i);
+    }
+    if (std::fwrite(&data[0], 1, FILE_LENGTH, file) != FILE_LENGTH
+                                            || std::fflush(file) != 0) {
+        fail("Temporary file write failed");
+    }
+    off_t offset = 0;
+    while (offset < static_cast<off_t>(FILE_LENGTH)) {
+        if (::sendfile(fd, ::fileno(file), &offset, FILE_LENGTH - offset) < 0) {
+            fail(std::string("sendfile: ") + std::strerror(errno));
+        }
+    }
+    std::fclose(file);
+
+}
+
+/*
+ * Transfer bytes from server to client, through the kernel if
+ * offloaded. Returns the server's transmit time in seconds.
+ */
+double transfer(CKTLS::CipherSuite suite, uint64_t bytes, bool offloaded) {
+
+    CKTLS::CipherSuiteList preferred;
+    preferred.push_back(suite);
+    CKTLS::CipherSuiteManager::setServerPreferred(preferred);
+
+    int fds[2];
+    loopback(fds);
+    uint64_t expected = offloaded ? bytes + FILE_LENGTH : bytes;
+    bool ok;
+    std::thread client(receive, fds[0], expected, std::ref(ok));
+
+    CKTLS::TLSConnection server(CKTLS::server);
+    handshake(server, fds[1]);
+    if (offloaded && !server.offload(fds[1])) {
+        fail("The kernel refused the connection state");
+    }
+
+    std::vector<uint8_t> chunk(CHUNK);
+    Clock::time_point start = Clock::now();
+    for (uint64_t offset = 0; offset < bytes; offset += CHUNK) {
+        unsigned length = bytes - offset < CHUNK ? bytes - offset : CHUNK;
+        for (unsigned i = 0; i < length; ++i) {
+            chunk[i] = pattern(offset + i);
+        }
+        server.write(&chunk[0], length);
+        flush(server, fds[1]);
+    }
+    if (offloaded) {
+        sendFile(fds[1], bytes);
+    }
+    server.close();
+    flush(server, fds[1]);
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    client.join();
+    ::close(fds[0]);
+    ::close(fds[1]);
+    if (!ok) {
+        fail("Transfer check failed");
+    }
+    return seconds;
+
+}
+
+void createIdentity() {
+
+    CK::RSAKeyPairGenerator gen;
+    gen.setKeySize(2048);
+    CK::KeyPair<CK::RSAPublicKey, CK::RSAPrivateKey> *pair = gen.generateKeyPair();
+    CKTLS::ServerCertificate::setRSAPrivateKey(pair->privateKey());
+
+    CKTLS::PGPCertificate *cert = new CKTLS::PGPCertificate;
+    cert->setPublicKey(new CKPGP::PublicKey(pair->publicKey()));
+    cert->addUserID(CKPGP::UserID("CryptoKitty-TLS benchmark"),
+                                                        CKPGP::Signature());
+    CKTLS::TLSConnection::setCertificate(cert);
+
+}
+
+void report(const char *name, const char *path, uint64_t bytes, double seconds) {
+
+    std::cout << std::fixed << std::setprecision(1)
+              << name << " " << path << ": "
+              << (bytes / seconds) / (1024 * 1024) << " MB/s" << std::endl;
+
+}
+
+}
+
+int main(int argc, char *argv[]) {
+
+    uint64_t megabytes = 64;
+    if (argc > 1) {
+        megabytes = std::strtoul(argv[1], 0, 10);
+    }
+    if (megabytes == 0) {
+        megabytes = 1;
+    }
+    uint64_t bytes = megabytes * 1024 * 1024;
+
+    createIdentity();
+    bool kernel = kernelTLSLoaded();
+    if (!kernel) {
+        std::cout << "Kernel TLS unavailable (no tls module), "
+                  << "kernel runs skipped" << std::endl;
+    }
+
+    struct {
+        CKTLS::CipherSuite suite;
+        const char *name;
+    } suites[] = {
+        { CKTLS::TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256, "AES-128-GCM" },
+        { CKTLS::TLS_ECDHE_RSA_WITH_AES_256_GCM_SHA384, "AES-256-GCM" }
+    };
+    for (unsigned i = 0; i < sizeof(suites) / sizeof(suites[0]); ++i) {
+        report(suites[i].name, "user space", bytes,
+                                    transfer(suites[i].suite, bytes, false));
+        if (kernel) {
+            report(suites[i].name, "kernel TLS", bytes + FILE_LENGTH,
+                                    transfer(suites[i].suite, bytes, true));
+        }
+    }
+
+    return 0;
+
+}
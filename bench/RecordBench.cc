@@ -0,0 +1,174 @@
+/*
+ * Record layer throughput benchmark. Seals and opens application
+ * data records through a StateContainer with AES-GCM and reports
+ * MB/s, records/s and heap allocations per record.
+ */
+#include "tls/CipherText.h"
+#include "tls/ConnectionState.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#ifdef _TLS_THREAD_LOCAL_
+#error "The record benchmark requires StateContainer connection states"
+#endif
+
+static std::atomic<unsigned long> allocations(0);
+
+void *operator new(std::size_t size) {
+
+    allocations++;
+    void *p = std::malloc(size == 0 ? 1 : size);
+    if (p == 0) {
+        throw std::bad_alloc();
+    }
+    return p;
+
+}
+
+void operator delete(void *p) noexcept {
+
+    std::free(p);
+
+}
+
+namespace {
+
+/*
+ * Initialize a connection state as a negotiated AES-GCM state.
+ */
+void initState(CKTLS::ConnectionState *state, CKTLS::ConnectionEnd end,
+                                                        uint32_t keyLength) {
+
+    state->setEntity(end);
+    state->setCipherType(CKTLS::aead);
+    state->setCipherAlgorithm(CKTLS::aes);
+    state->setEncryptionKeyLength(keyLength);
+    state->setHMAC(keyLength == 128 ? CKTLS::hmac_sha256 : CKTLS::hmac_sha384);
+    state->setClientRandom(coder::ByteArray(32, 0x5a));
+    state->setServerRandom(coder::ByteArray(32, 0xa5));
+    state->generateKeys(coder::ByteArray(48, 0x3c));
+    state->setInitialized();
+
+}
+
+struct Result {
+    double seconds;
+    unsigned long allocs;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+/*
+ * Both ends of a connection. Records sealed by the server are opened
+ * by the client.
+ */
+struct Ends {
+    CKTLS::StateContainer server;
+    CKTLS::StateContainer client;
+};
+
+/*
+ * Encode and decode using the ByteArray record interface.
+ */
+Result runByteArray(Ends& ends, unsigned size, unsigned count) {
+
+    coder::ByteArray plaintext(size, 0x41);
+    CKTLS::CipherText sealer(&ends.server);
+    sealer.setPlaintext(plaintext);
+
+    Result result;
+    unsigned long before = allocations;
+    Clock::time_point start = Clock::now();
+    for (unsigned i = 0; i < count; ++i) {
+        const coder::ByteArray& record(sealer.encodeRecord());
+        CKTLS::CipherText opener(&ends.client);
+        opener.decodePreamble(record.range(0, 5));
+        opener.setFragment(record.range(5, record.getLength() - 5));
+        opener.decodeRecord();
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    result.allocs = allocations - before;
+    return result;
+
+}
+
+/*
+ * Encode into a caller buffer and decrypt in place.
+ */
+Result runBuffer(Ends& ends, unsigned size, unsigned count) {
+
+    coder::ByteArray plaintext(size, 0x41);
+    CKTLS::CipherText sealer(&ends.server);
+    sealer.setPlaintext(plaintext);
+    CKTLS::CipherText opener(&ends.client);
+    std::vector<uint8_t> buffer(size + 64);
+
+    Result result;
+    unsigned long before = allocations;
+    Clock::time_point start = Clock::now();
+    for (unsigned i = 0; i < count; ++i) {
+        unsigned length = sealer.encodeRecord(&buffer[0], buffer.size());
+        opener.decodeInPlace(&buffer[0], length);
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    result.allocs = allocations - before;
+    return result;
+
+}
+
+void report(const char *mode, uint32_t keyLength, unsigned size,
+                                        unsigned count, const Result& r) {
+
+    double mb = (static_cast<double>(size) * count) / (1024 * 1024);
+    std::cout << std::left << std::setw(10) << mode
+              << "AES-" << std::setw(4) << keyLength
+              << std::right << std::setw(7) << size << " B"
+              << std::fixed << std::setprecision(2)
+              << std::setw(12) << mb / r.seconds << " MB/s"
+              << std::setw(12) << std::setprecision(0) << count / r.seconds << " rec/s"
+              << std::setw(10) << std::setprecision(1)
+              << static_cast<double>(r.allocs) / count << " alloc/rec"
+              << std::endl;
+
+}
+
+}
+
+int main(int argc, char *argv[]) {
+
+    // Total bytes sealed and opened per measurement.
+    unsigned long volume = 16 * 1024 * 1024;
+    if (argc > 1) {
+        volume = std::strtoul(argv[1], 0, 10) * 1024 * 1024;
+    }
+
+    const unsigned sizes[] = { 64, 256, 1024, 4096, 16384 };
+    const uint32_t keyLengths[] = { 128, 256 };
+
+    for (unsigned k = 0; k < 2; ++k) {
+        Ends ends;
+        initState(ends.server.getPendingRead(), CKTLS::server, keyLengths[k]);
+        ends.server.getPendingRead()->promoteRead(&ends.server);
+        initState(ends.client.getPendingWrite(), CKTLS::client, keyLengths[k]);
+        ends.client.getPendingWrite()->promoteWrite(&ends.client);
+
+        for (unsigned s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+            unsigned count = volume / sizes[s];
+            if (count < 16) {
+                count = 16;
+            }
+            report("bytearray", keyLengths[k], sizes[s], count,
+                                runByteArray(ends, sizes[s], count));
+            report("buffer", keyLengths[k], sizes[s], count,
+                                runBuffer(ends, sizes[s], count));
+        }
+    }
+
+    return 0;
+
+}
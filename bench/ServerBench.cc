@@ -0,0 +1,366 @@
+/*
+ * Server engine benchmark and loopback check. Starts a TLSServer that
+ * echoes application data, with the epoll backend and then the
+ * io_uring backend, and runs TLSConnection clients against it over
+ * TCP loopback from several threads. Every client checks every byte
+ * of its echo. Reports handshakes/s and echo throughput per backend.
+ *
+ * Each backend is also run out of descriptors, with connections
+ * waiting that it can't accept. Its loop must not spin on them, and
+ * it must serve again once descriptors are free.
+ */
+#include "tls/TLSServer.h"
+#include "tls/TLSConnection.h"
+#include "tls/CipherSuiteManager.h"
+#include "tls/PGPCertificate.h"
+#include "tls/ServerCertificate.h"
+#include "tls/exceptions/RecordException.h"
+#include <CryptoKitty-C/keys/RSAKeyPairGenerator.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef _TLS_THREAD_LOCAL_
+#error "The server benchmark requires StateContainer connection states"
+#endif
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const unsigned CLIENT_THREADS = 4;
+const unsigned CHUNK = 16 * 1024;
+
+std::atomic<unsigned> failures(0);
+
+uint8_t pattern(uint64_t offset) {
+
+    return offset % 251;
+
+}
+
+void fail(const std::string& what) {
+
+    std::cerr << what << std::endl;
+    std::exit(1);
+
+}
+
+/*
+ * A free loopback port for the server's SO_REUSEPORT listeners.
+ */
+uint16_t freePort() {
+
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(addr);
+    if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&addr), length) != 0
+            || ::getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &length) != 0) {
+        fail(std::string("Port selection failed: ") + std::strerror(errno));
+    }
+    ::close(fd);
+    return ntohs(addr.sin_port);
+
+}
+
+int connectTo(uint16_t port) {
+
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        throw CKTLS::RecordException(std::string("Connect failed: ")
+                                                    + std::strerror(errno));
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+
+}
+
+void fill(CKTLS::TLSConnection& connection, int fd) {
+
+    unsigned available;
+    uint8_t *space = connection.getReadBuffer(available);
+    ssize_t count = ::read(fd, space, available);
+    if (count <= 0) {
+        throw CKTLS::RecordException("Loopback read failed");
+    }
+    connection.commitRead(count);
+
+}
+
+void flush(CKTLS::TLSConnection& connection, int fd) {
+
+    while (!connection.flush(fd)) {
+    }
+
+}
+
+void handshake(CKTLS::TLSConnection& connection, int fd) {
+
+    for (;;) {
+        switch (connection.handshake()) {
+            case CKTLS::TLSConnection::complete:
+                return;
+            case CKTLS::TLSConnection::want_write:
+                flush(connection, fd);
+                break;
+            case CKTLS::TLSConnection::want_read:
+                fill(connection, fd);
+                break;
+            default:
+                throw CKTLS::RecordException("Unexpected handshake status");
+        }
+    }
+
+}
+
+/*
+ * One connection. Writes a chunk at a time and reads its echo.
+ */
+void exchange(uint16_t port, uint64_t bytes) {
+
+    int fd = connectTo(port);
+    try {
+        CKTLS::TLSConnection connection(CKTLS::client);
+        handshake(connection, fd);
+        std::vector<uint8_t> chunk(CHUNK);
+        CKTLS::RecordView view;
+        for (uint64_t offset = 0; offset < bytes; offset += CHUNK) {
+            unsigned length = bytes - offset < CHUNK ? bytes - offset : CHUNK;
+            for (unsigned i = 0; i < length; ++i) {
+                chunk[i] = pattern(offset + i);
+            }
+            connection.write(&chunk[0], length);
+            flush(connection, fd);
+            unsigned received = 0;
+            while (received < length) {
+                CKTLS::TLSConnection::Status status = connection.read(view);
+                if (status == CKTLS::TLSConnection::closed) {
+                    throw CKTLS::RecordException("Echo closed early");
+                }
+                if (status != CKTLS::TLSConnection::complete) {
+                    fill(connection, fd);
+                    continue;
+                }
+                for (unsigned i = 0; i < view.length; ++i) {
+                    if (view.data[i] != pattern(offset + received + i)) {
+                        throw CKTLS::RecordException("Echo mismatch");
+                    }
+                }
+                received += view.length;
+            }
+        }
+        connection.close();
+        flush(connection, fd);
+    }
+    catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+
+}
+
+double cpuSeconds() {
+
+    rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+            + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+
+}
+
+void client(uint16_t port, unsigned connections, uint64_t bytes) {
+
+    for (unsigned i = 0; i < connections; ++i) {
+        try {
+            exchange(port, bytes);
+        }
+        catch (CKTLS::RecordException& e) {
+            std::cerr << "Client: " << e.what() << std::endl;
+            failures++;
+        }
+    }
+
+}
+
+void run(CKTLS::TLSServer::IOBackend backend, const char *name,
+                                    unsigned connections, uint64_t bytes) {
+
+    uint16_t port = freePort();
+    CKTLS::TLSServer server(port, 2, backend);
+    server.setDataCallback([](CKTLS::TLSConnection& connection,
+                                        const uint8_t *data, unsigned length) {
+        connection.write(data, length);
+    });
+    server.start();
+    if (server.getBackend() != backend) {
+        std::cout << name << ": not available, ran on epoll" << std::endl;
+    }
+
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> clients;
+    unsigned perThread = (connections + CLIENT_THREADS - 1) / CLIENT_THREADS;
+    for (unsigned i = 0; i < CLIENT_THREADS; ++i) {
+        clients.push_back(std::thread(client, port, perThread, bytes));
+    }
+    for (unsigned i = 0; i < clients.size(); ++i) {
+        clients[i].join();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    uint64_t handshakes = server.getHandshakes();
+    server.stop();
+    unsigned total = perThread * CLIENT_THREADS;
+    if (failures > 0) {
+        fail(name + std::string(": connections failed"));
+    }
+    if (handshakes != total) {
+        std::cerr << name << ": server counted " << handshakes << " of "
+                  << total << " handshakes" << std::endl;
+        std::exit(1);
+    }
+    std::cout << name << ": " << total << " connections, " << bytes / 1024
+              << " KB echoed each" << std::endl << std::fixed
+              << std::setprecision(1)
+              << "  " << total / seconds << " connections/s" << std::endl
+              << "  " << (total * bytes * 2.0) / seconds / (1024 * 1024)
+              << " MB/s echo" << std::endl;
+
+}
+
+/*
+ * Fill the descriptor table with client sockets and connect them, so
+ * the server can't accept any of them, then measure the CPU the
+ * server uses while they wait.
+ */
+void exhaust(CKTLS::TLSServer::IOBackend backend, const char *name) {
+
+    uint16_t port = freePort();
+    CKTLS::TLSServer server(port, 1, backend);
+    server.setDataCallback([](CKTLS::TLSConnection& connection,
+                                        const uint8_t *data, unsigned length) {
+        connection.write(data, length);
+    });
+    server.start();
+
+    rlimit saved;
+    ::getrlimit(RLIMIT_NOFILE, &saved);
+    int lowest = ::dup(0);
+    ::close(lowest);
+    rlimit low = saved;
+    low.rlim_cur = lowest + 32;
+    if (::setrlimit(RLIMIT_NOFILE, &low) != 0) {
+        fail(std::string("setrlimit: ") + std::strerror(errno));
+    }
+    std::vector<int> held;
+    for (;;) {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) {
+            break;
+        }
+        held.push_back(fd);
+    }
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    for (unsigned i = 0; i < held.size(); ++i) {
+        ::connect(held[i], reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    }
+
+    double cpu = cpuSeconds();
+    Clock::time_point start = Clock::now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    double used = (cpuSeconds() - cpu)
+            / std::chrono::duration<double>(Clock::now() - start).count();
+
+    for (unsigned i = 0; i < held.size(); ++i) {
+        ::close(held[i]);
+    }
+    ::setrlimit(RLIMIT_NOFILE, &saved);
+    std::cout << name << ": out of descriptors with " << held.size()
+              << " connections waiting, server used " << std::fixed
+              << std::setprecision(1) << used * 100 << " % of a core"
+              << std::endl;
+    if (used > 0.25) {
+        fail(name + std::string(": server loop spun while out of descriptors"));
+    }
+
+    try {
+        exchange(port, 2 * CHUNK);
+    }
+    catch (CKTLS::RecordException& e) {
+        fail(name + std::string(": no service after descriptors were freed: ")
+                                                            + e.what());
+    }
+    server.stop();
+
+}
+
+void createIdentity() {
+
+    CK::RSAKeyPairGenerator gen;
+    gen.setKeySize(2048);
+    CK::KeyPair<CK::RSAPublicKey, CK::RSAPrivateKey> *pair = gen.generateKeyPair();
+    CKTLS::ServerCertificate::setRSAPrivateKey(pair->privateKey());
+
+    CKTLS::PGPCertificate *cert = new CKTLS::PGPCertificate;
+    cert->setPublicKey(new CKPGP::PublicKey(pair->publicKey()));
+    cert->addUserID(CKPGP::UserID("CryptoKitty-TLS benchmark"),
+                                                        CKPGP::Signature());
+    CKTLS::TLSConnection::setCertificate(cert);
+
+}
+
+}
+
+int main(int argc, char *argv[]) {
+
+    unsigned connections = 200;
+    uint64_t bytes = 256 * 1024;
+    if (argc > 1) {
+        connections = std::strtoul(argv[1], 0, 10);
+    }
+    if (argc > 2) {
+        bytes = std::strtoul(argv[2], 0, 10) * 1024;
+    }
+    if (connections == 0) {
+        connections = 1;
+    }
+
+    createIdentity();
+    CKTLS::CipherSuiteList preferred;
+    preferred.push_back(CKTLS::TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256);
+    CKTLS::CipherSuiteManager::setServerPreferred(preferred);
+
+    run(CKTLS::TLSServer::epoll_io, "epoll", connections, bytes);
+    run(CKTLS::TLSServer::uring_io, "io_uring", connections, bytes);
+    exhaust(CKTLS::TLSServer::epoll_io, "epoll");
+    exhaust(CKTLS::TLSServer::uring_io, "io_uring");
+
+    return 0;
+
+}
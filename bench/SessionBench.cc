@@ -0,0 +1,130 @@
+/*
+ * Session cache scaling benchmark. Runs resumption lookups from a
+ * growing number of threads, with one store for every fifteen
+ * lookups, and reports operations/s, scaling against one thread and
+ * the cache's hit, miss and eviction counts.
+ */
+#include "tls/SessionCache.h"
+#include "tls/ConnectionState.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#ifdef _TLS_THREAD_LOCAL_
+#error "The session benchmark requires StateContainer connection states"
+#endif
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const unsigned SESSIONS = 100000;
+const unsigned STORE_INTERVAL = 16;
+const double SECONDS = 2.0;
+
+std::vector<coder::ByteArray> ids;
+CKTLS::ConnectionState *state;
+std::atomic<bool> running;
+
+/*
+ * One resuming thread. Returns the operation count through ops.
+ */
+void worker(CKTLS::SessionCache *cache, unsigned seed, unsigned long *ops) {
+
+    CKTLS::Session session;
+    unsigned long count = 0;
+    unsigned index = seed;
+    while (running.load(std::memory_order_relaxed)) {
+        index = index * 1103515245 + 12345;
+        const coder::ByteArray& id(ids[(index >> 8) % ids.size()]);
+        if (count % STORE_INTERVAL == 0) {
+            cache->store(id, *state);
+        }
+        else {
+            cache->find(id, session);
+        }
+        count++;
+    }
+    *ops = count;
+
+}
+
+double run(CKTLS::SessionCache& cache, unsigned threads) {
+
+    std::vector<unsigned long> ops(threads);
+    std::vector<std::thread> workers;
+    running.store(true);
+    Clock::time_point begin = Clock::now();
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.push_back(std::thread(worker, &cache, t, &ops[t]));
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(SECONDS));
+    running.store(false);
+    for (unsigned t = 0; t < threads; ++t) {
+        workers[t].join();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    unsigned long total = 0;
+    for (unsigned t = 0; t < threads; ++t) {
+        total += ops[t];
+    }
+    return total / seconds;
+
+}
+
+}
+
+int main(int argc, char *argv[]) {
+
+    unsigned maxThreads = std::thread::hardware_concurrency();
+    if (argc > 1) {
+        maxThreads = std::strtoul(argv[1], 0, 10);
+    }
+    if (maxThreads == 0) {
+        maxThreads = 1;
+    }
+    unsigned shards = CKTLS::SessionCache::DEFAULT_SHARDS;
+    if (argc > 2) {
+        shards = std::strtoul(argv[2], 0, 10);
+    }
+
+    state = new CKTLS::ConnectionState;
+    state->setCipherSuite(CKTLS::TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256);
+    state->setClientRandom(coder::ByteArray(32, 1));
+    state->setServerRandom(coder::ByteArray(32, 2));
+    state->resumeKeys(coder::ByteArray(48, 3));
+
+    CKTLS::SessionCache cache(SESSIONS, CKTLS::SessionCache::DEFAULT_LIFETIME, shards);
+    for (unsigned i = 0; i < SESSIONS / 2; ++i) {
+        ids.push_back(CKTLS::SessionCache::newSessionID());
+        cache.store(ids.back(), *state);
+    }
+
+    std::cout << cache.getShardCount() << " shards, " << SESSIONS
+              << " sessions" << std::endl;
+    double single = 0;
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        double rate = run(cache, threads);
+        if (threads == 1) {
+            single = rate;
+        }
+        std::cout << std::setw(4) << threads << " threads: " << std::fixed
+                  << std::setprecision(0) << std::setw(12) << rate << " ops/s"
+                  << std::setprecision(2) << std::setw(8) << rate / single
+                  << "x" << std::endl;
+        if (threads < maxThreads && threads * 2 > maxThreads) {
+            threads = maxThreads / 2;
+        }
+    }
+    std::cout << "hits " << cache.getHits() << ", misses " << cache.getMisses()
+              << ", evictions " << cache.getEvictions() << std::endl;
+
+    delete state;
+    return 0;
+
+}
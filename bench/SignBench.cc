@@ -0,0 +1,105 @@
+/*
+ * ServerKeyExchange signing benchmark. Signs a burst of concurrent
+ * handshakes' worth of ServerKeyExchange data inline and through the
+ * asynchronous signer, and reports signatures/s and signatures/s per
+ * signing thread.
+ */
+#include "tls/AsyncSigner.h"
+#include "tls/ServerCertificate.h"
+#include "tls/ServerKeyExchange.h"
+#include <CryptoKitty-C/keys/RSAKeyPairGenerator.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// clientRandom || serverRandom || ServerECDHParams for secp256r1.
+const unsigned SIGNED_LENGTH = 32 + 32 + 4 + 65;
+
+void report(const char *name, unsigned count, double seconds, unsigned threads) {
+
+    std::cout << std::left << std::setw(28) << name << std::right << std::fixed
+              << std::setprecision(1) << std::setw(10) << count / seconds
+              << " sig/s" << std::setw(10) << count / seconds / threads
+              << " sig/s/thread" << std::endl;
+
+}
+
+void runInline(unsigned count) {
+
+    coder::ByteArray data(SIGNED_LENGTH, 0x5a);
+    Clock::time_point begin = Clock::now();
+    for (unsigned i = 0; i < count; ++i) {
+        CKTLS::ServerKeyExchange::sign(data);
+    }
+    report("inline", count,
+            std::chrono::duration<double>(Clock::now() - begin).count(), 1);
+
+}
+
+/*
+ * Submit the whole burst at once, as many simultaneous handshakes
+ * would, and wait for the last callback.
+ */
+void runAsync(unsigned count, unsigned threads) {
+
+    std::mutex lock;
+    std::condition_variable finished;
+    unsigned done = 0;
+    coder::ByteArray data(SIGNED_LENGTH, 0x5a);
+
+    CKTLS::AsyncSigner signer(threads);
+    Clock::time_point begin = Clock::now();
+    for (unsigned i = 0; i < count; ++i) {
+        signer.submit(data, [&](const coder::ByteArray& sig) {
+            std::lock_guard<std::mutex> guard(lock);
+            if (++done == count) {
+                finished.notify_one();
+            }
+        });
+    }
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        while (done < count) {
+            finished.wait(guard);
+        }
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    report("async", count, seconds, threads);
+
+}
+
+}
+
+int main(int argc, char *argv[]) {
+
+    unsigned count = 500;
+    if (argc > 1) {
+        count = std::strtoul(argv[1], 0, 10);
+    }
+    if (count == 0) {
+        count = 1;
+    }
+    unsigned threads = std::thread::hardware_concurrency();
+    if (threads == 0) {
+        threads = 1;
+    }
+
+    CK::RSAKeyPairGenerator gen;
+    gen.setKeySize(2048);
+    CK::KeyPair<CK::RSAPublicKey, CK::RSAPrivateKey> *pair = gen.generateKeyPair();
+    CKTLS::ServerCertificate::setRSAPrivateKey(pair->privateKey());
+
+    runInline(count);
+    runAsync(count, threads);
+
+    return 0;
+
+}
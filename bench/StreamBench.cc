@@ -0,0 +1,208 @@
+/*
+ * Coroutine stream benchmark and loopback check. Runs client and
+ * server TLSStreams for many socket pairs on one reactor thread. The
+ * servers sign their ServerKeyExchange on an AsyncSigner and echo what
+ * they read. Each client writes from one coroutine while another reads
+ * the echo, so the reactor has a reader and a writer waiting on the
+ * same socket, and checks every byte. Reports handshakes/s and echo
+ * throughput.
+ */
+#include "tls/TLSStream.h"
+#include "tls/AsyncSigner.h"
+#include "tls/CipherSuiteManager.h"
+#include "tls/PGPCertificate.h"
+#include "tls/ServerCertificate.h"
+#include "tls/exceptions/RecordException.h"
+#include <CryptoKitty-C/keys/RSAKeyPairGenerator.h>
+#include <chrono>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const unsigned CHUNK = 16 * 1024;
+
+/*
+ * Shared by all the pairs. Only touched on the reactor thread.
+ */
+struct Totals {
+    unsigned remaining;         // Clients still running.
+    unsigned failures;
+    Clock::time_point handshakes;   // When the last handshake finished.
+    unsigned handshaken;
+    unsigned pairs;
+};
+
+uint8_t pattern(uint64_t offset) {
+
+    return offset % 251;
+
+}
+
+void finish(CKTLS::Reactor& reactor, Totals& totals) {
+
+    if (--totals.remaining == 0) {
+        reactor.stop();
+    }
+
+}
+
+CKTLS::Task<void> echo(CKTLS::Reactor& reactor, int fd, Totals& totals) {
+
+    try {
+        CKTLS::TLSStream stream(reactor, fd, CKTLS::server);
+        co_await stream.handshake();
+        CKTLS::RecordView view;
+        while (co_await stream.read(view)) {
+            co_await stream.write(view.data, view.length);
+        }
+    }
+    catch (CKTLS::RecordException& e) {
+        std::cerr << "Server: " << e.what() << std::endl;
+        totals.failures++;
+    }
+    ::close(fd);
+
+}
+
+CKTLS::Task<void> produce(CKTLS::TLSStream& stream, uint64_t bytes) {
+
+    std::vector<uint8_t> chunk(CHUNK);
+    for (uint64_t offset = 0; offset < bytes; offset += CHUNK) {
+        unsigned length = bytes - offset < CHUNK ? bytes - offset : CHUNK;
+        for (unsigned i = 0; i < length; ++i) {
+            chunk[i] = pattern(offset + i);
+        }
+        co_await stream.write(&chunk[0], length);
+    }
+
+}
+
+/*
+ * The writer runs as its own task. The echo of the last byte can't
+ * arrive before the writer has sent it, so the stream outlives it.
+ */
+CKTLS::Task<void> request(CKTLS::Reactor& reactor, int fd, uint64_t bytes,
+                                                        Totals& totals) {
+
+    try {
+        CKTLS::TLSStream stream(reactor, fd, CKTLS::client);
+        co_await stream.handshake();
+        if (++totals.handshaken == totals.pairs) {
+            totals.handshakes = Clock::now();
+        }
+        reactor.spawn(produce(stream, bytes));
+
+        uint64_t received = 0;
+        CKTLS::RecordView view;
+        while (received < bytes) {
+            if (!co_await stream.read(view)) {
+                throw CKTLS::RecordException("Echo closed early");
+            }
+            for (unsigned i = 0; i < view.length; ++i) {
+                if (view.data[i] != pattern(received + i)) {
+                    throw CKTLS::RecordException("Echo mismatch");
+                }
+            }
+            received += view.length;
+        }
+        co_await stream.close();
+    }
+    catch (CKTLS::RecordException& e) {
+        std::cerr << "Client: " << e.what() << std::endl;
+        totals.failures++;
+    }
+    ::close(fd);
+    finish(reactor, totals);
+
+}
+
+void createIdentity() {
+
+    CK::RSAKeyPairGenerator gen;
+    gen.setKeySize(2048);
+    CK::KeyPair<CK::RSAPublicKey, CK::RSAPrivateKey> *pair = gen.generateKeyPair();
+    CKTLS::ServerCertificate::setRSAPrivateKey(pair->privateKey());
+
+    CKTLS::PGPCertificate *cert = new CKTLS::PGPCertificate;
+    cert->setPublicKey(new CKPGP::PublicKey(pair->publicKey()));
+    cert->addUserID(CKPGP::UserID("CryptoKitty-TLS benchmark"),
+                                                        CKPGP::Signature());
+    CKTLS::TLSConnection::setCertificate(cert);
+
+}
+
+}
+
+int main(int argc, char *argv[]) {
+
+    unsigned pairs = 100;
+    uint64_t bytes = 256 * 1024;
+    if (argc > 1) {
+        pairs = std::strtoul(argv[1], 0, 10);
+    }
+    if (argc > 2) {
+        bytes = std::strtoul(argv[2], 0, 10) * 1024;
+    }
+    if (pairs == 0) {
+        pairs = 1;
+    }
+
+    createIdentity();
+    CKTLS::CipherSuiteList preferred;
+    preferred.push_back(CKTLS::TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256);
+    CKTLS::CipherSuiteManager::setServerPreferred(preferred);
+    CKTLS::AsyncSigner signer;
+    CKTLS::TLSStream::setSigner(&signer);
+
+    CKTLS::Reactor reactor;
+    Totals totals;
+    totals.remaining = pairs;
+    totals.failures = 0;
+    totals.handshaken = 0;
+    totals.pairs = pairs;
+
+    Clock::time_point start = Clock::now();
+    for (unsigned i = 0; i < pairs; ++i) {
+        int fds[2];
+        if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            std::cerr << "socketpair: " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+        reactor.spawn(echo(reactor, fds[1], totals));
+        reactor.spawn(request(reactor, fds[0], bytes, totals));
+    }
+    std::thread loop(&CKTLS::Reactor::run, &reactor);
+    loop.join();
+    Clock::time_point end = Clock::now();
+
+    if (totals.failures > 0) {
+        std::cerr << totals.failures << " streams failed" << std::endl;
+        return 1;
+    }
+    if (signer.getSignatures() != pairs) {
+        std::cerr << "Expected " << pairs << " deferred signatures, got "
+                  << signer.getSignatures() << std::endl;
+        return 1;
+    }
+    double handshakeTime = std::chrono::duration<double>(totals.handshakes - start).count();
+    double total = std::chrono::duration<double>(end - start).count();
+    std::cout << pairs << " streams, " << bytes / 1024 << " KB echoed each"
+              << std::endl << std::fixed << std::setprecision(1)
+              << "  " << pairs / handshakeTime << " handshakes/s" << std::endl
+              << "  " << (pairs * bytes * 2.0) / total / (1024 * 1024)
+              << " MB/s echo" << std::endl;
+
+    return 0;
+
+}
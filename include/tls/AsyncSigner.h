@@ -0,0 +1,72 @@
+#ifndef ASYNCSIGNER_H_INCLUDED
+#define ASYNCSIGNER_H_INCLUDED
+
+#include "coder/ByteArray.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace CKTLS {
+
+/*
+ * ServerKeyExchange signing thread pool. A handshake submits the
+ * ServerKeyExchange signed data and continues once its callback
+ * delivers the signature, so the connection's thread never blocks
+ * on the RSA private key operation.
+ *
+ *     data = ske->getSignedData();
+ *     signer.submit(data, [=](const coder::ByteArray& sig) {
+ *         ske->setSignature(sig);
+ *         // Wake the connection to send the ServerKeyExchange.
+ *     });
+ */
+class AsyncSigner {
+
+    public:
+        // Called on a signing thread. The signature is empty if signing failed.
+        typedef std::function<void(const coder::ByteArray& signature)> Callback;
+
+    public:
+        AsyncSigner(unsigned threads = DEFAULT_THREADS);
+        ~AsyncSigner();
+
+    private:
+        AsyncSigner(const AsyncSigner& other);
+        AsyncSigner& operator= (const AsyncSigner& other);
+
+    public:
+        // Number of requests waiting for a signing thread.
+        unsigned getQueueLength();
+        // Number of requests signed.
+        uint64_t getSignatures() const;
+        // Queue data for signing.
+        void submit(const coder::ByteArray& data, const Callback& done);
+
+    public:
+        static const unsigned DEFAULT_THREADS;
+
+    private:
+        void work();
+
+    private:
+        struct Request {
+            coder::ByteArray data;
+            Callback done;
+        };
+
+        std::deque<Request> requests;
+        std::mutex lock;
+        std::condition_variable ready;
+        bool stopping;
+        std::vector<std::thread> workers;
+        std::atomic<uint64_t> signatures;
+
+};
+
+}
+
+#endif  // ASYNCSIGNER_H_INCLUDED
@@ -0,0 +1,85 @@
+#ifndef CERTIFICATECACHE_H_INCLUDED
+#define CERTIFICATECACHE_H_INCLUDED
+
+#include "coder/ByteArray.h"
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace CK {
+    class RSAPublicKey;
+}
+
+namespace CKTLS {
+
+class PGPCertificate;
+
+/*
+ * Client side cache of parsed server certificates. Certificates are
+ * found by fingerprint, for servers that send only the fingerprint
+ * (RFC 6091 Section 3.3), or by the SHA-256 hash of the encoded
+ * certificate, so that a certificate received in full is only parsed
+ * the first time it is seen. The least recently used certificate is
+ * dropped when the cache is full.
+ */
+class CertificateCache {
+
+    public:
+        typedef std::shared_ptr<PGPCertificate> CertificatePtr;
+
+        struct CachedCertificate {
+            CertificatePtr cert;
+            CK::RSAPublicKey *publicKey;    // Owned by cert.
+        };
+
+    public:
+        CertificateCache(unsigned maxCertificates = DEFAULT_SIZE);
+        ~CertificateCache();
+
+    private:
+        CertificateCache(const CertificateCache& other);
+        CertificateCache& operator= (const CertificateCache& other);
+
+    public:
+        // Add a certificate, e.g. one that was provisioned.
+        void add(const CertificatePtr& cert);
+        // Returns the parsed certificate, parsing it on a miss.
+        CachedCertificate decode(const coder::ByteArray& encoded);
+        // Returns an empty certificate if the fingerprint isn't cached.
+        CachedCertificate find(const coder::ByteArray& fingerprint);
+        uint64_t getHits() const;
+        uint64_t getMisses() const;
+
+    public:
+        static const unsigned DEFAULT_SIZE;
+
+    private:
+        struct Entry {
+            CachedCertificate value;
+            std::string fingerprint;
+            std::string digest;
+        };
+        typedef std::list<Entry> EntryList;     // Most recently used first.
+        typedef std::map<std::string, EntryList::iterator> EntryMap;
+
+        CachedCertificate insert(const Entry& entry);
+        static Entry makeEntry(const CertificatePtr& cert,
+                                        const coder::ByteArray& encoded);
+        static std::string makeKey(const coder::ByteArray& bytes);
+
+    private:
+        unsigned maxCertificates;
+        EntryList entries;
+        EntryMap fingerprints;
+        EntryMap digests;
+        uint64_t hits;
+        uint64_t misses;
+        mutable std::mutex lock;
+
+};
+
+}
+
+#endif  // CERTIFICATECACHE_H_INCLUDED
@@ -3,10 +3,6 @@
 
 #include "RecordProtocol.h"
 
-namespace CK {
-    class Cipher;
-}
-
 namespace CKTLS {
 
 class ConnectionState;
@@ -32,9 +28,6 @@ class ChangeCipherSpec : public RecordProtocol {
         void decode();
         void encode();
 
-    private:
-        CK::Cipher *getCipher(ConnectionState *state) const;
-
     private:
 #ifndef _TLS_THREAD_LOCAL_
         StateContainer *holder;
@@ -36,6 +36,8 @@ class CipherSuiteManager {
         void loadPreferred();
         CipherSuite matchCipherSuite() const;
         void setPreferred(CipherSuite c);
+        // Replace the server's suite preference list.
+        static void setServerPreferred(const CipherSuiteList& list);
 
     private:
         void initialize();
@@ -3,23 +3,25 @@
 
 #include "RecordProtocol.h"
 
-namespace CK {
-    class Cipher;
-}
-
 namespace CKTLS {
 
+class ConnectionState;
 #ifndef _TLS_THREAD_LOCAL_
 class StateContainer;
 #endif
 
+/*
+ * A protected record. Application data by default. Alerts sent once
+ * the connection has keys are protected the same way, with their own
+ * content type in the header and additional data.
+ */
 class CipherText : public RecordProtocol {
 
     public:
 #ifdef _TLS_THREAD_LOCAL_
-        CipherText();
+        CipherText(ContentType type = application_data);
 #else
-        CipherText(StateContainer *holder);
+        CipherText(StateContainer *holder, ContentType type = application_data);
 #endif
         ~CipherText();
 
@@ -28,6 +30,10 @@ class CipherText : public RecordProtocol {
         CipherText& operator= (const CipherText& other);
 
     public:
+        // Authenticate and decrypt a complete record, writing the
+        // plaintext back over it. Returns a view of the plaintext
+        // inside the record buffer.
+        RecordView decodeInPlace(uint8_t *record, unsigned length);
         const coder::ByteArray& getPlaintext() const { return plaintext; }
         //void setAlgorithm(BulkCipherAlgorithm alg);
         //void setCipherType(CipherType cipher);
@@ -40,10 +46,12 @@ class CipherText : public RecordProtocol {
     protected:
         void encode();
         void decode();
+        unsigned encodeFragment(uint8_t *buffer, unsigned length);
 
     private:
-        void decryptGCM(CK::Cipher *cipher);
-        void encryptGCM(CK::Cipher *cipher);
+        coder::ByteArray authData(ConnectionState *state, uint16_t length) const;
+        void decryptGCM(ConnectionState *state);
+        void encryptGCM(ConnectionState *state);
 
     private:
         //BulkCipherAlgorithm algorithm;
@@ -19,12 +19,15 @@ class ClientHello : public HandshakeBody {
 #ifdef _DEBUG
         void debugOut(std::ostream& out);
 #endif
+        void addExtension(const Extension& ext);
         const coder::ByteArray& encode();
         bool getExtension(uint16_t etype, Extension& ex) const;
         uint8_t getMajorVersion() const;
         uint8_t getMinorVersion() const;
         const coder::ByteArray& getRandom() const;
+        const coder::ByteArray& getSessionID() const;
         void initState();
+        void setSessionID(const coder::ByteArray& id);
         CipherSuite getPreferred() const;
 
     protected:
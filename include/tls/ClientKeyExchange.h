@@ -12,10 +12,18 @@ namespace CK {
 
 namespace CKTLS {
 
+#ifndef _TLS_THREAD_LOCAL_
+    class StateContainer;
+#endif
+
 class ClientKeyExchange : public HandshakeBody {
 
     public:
+#ifdef _TLS_THREAD_LOCAL_
         ClientKeyExchange();
+#else
+        ClientKeyExchange(StateContainer *holder);
+#endif
         ~ClientKeyExchange();
 
     private:
@@ -31,7 +39,6 @@ class ClientKeyExchange : public HandshakeBody {
         void initState(const CK::ECDHKeyExchange::CurveParams& p,
                                                 const coder::ByteArray& pk);
         void initState(const CK::BigInteger& pk);
-        static void setAlgorithm(KeyExchangeAlgorithm alg);
 
     protected:
         void decode();
@@ -43,7 +50,6 @@ class ClientKeyExchange : public HandshakeBody {
         coder::ByteArray encodeECDH() const;
 
     private:
-        static KeyExchangeAlgorithm algorithm;
         // ClientDHParams
         CK::BigInteger dYc;     // D-H public value.
         // EC parameters
@@ -74,6 +80,9 @@ class ClientKeyExchange : public HandshakeBody {
         
         // Key exchange
         coder::ByteArray ecPublicKey;
+#ifndef _TLS_THREAD_LOCAL_
+        StateContainer *holder;
+#endif
 
 };
 
@@ -8,6 +8,10 @@ namespace cthread {
     class ThreadLocal;
 }
 
+namespace CK {
+    class Cipher;
+}
+
 namespace CKTLS {
 
 #ifndef _TLS_THREAD_LOCAL_
@@ -25,26 +29,38 @@ class ConnectionState {
     public:
         // Generate the cyptography variables.
         void generateKeys(const coder::ByteArray& premasterSecret);
+        // Get the prepared AEAD block cipher.
+        CK::Cipher *getAEADCipher() const;
         // Get the block cipher algorithm.
         BulkCipherAlgorithm getCipherAlgorithm() const;
         // Get the block cipher mode.
         CipherType getCipherType() const;
+        // Get the negotiated cipher suite.
+        CipherSuite getCipherSuite() const;
         // Get the client random bytes for signatures.
         const coder::ByteArray& getClientRandom() const;
-        // Get the key for block encryption.
+        // Get the key for block encryption of records from the peer.
         const coder::ByteArray& getEncryptionKey() const;
         // gets the length of the block encryption key.
         uint32_t getEncryptionKeyLength() const;
         // Get the key for HMAC authentication.
         const coder::ByteArray& getMacKey() const;
-        // Get the IV for block encryption.
+        // Get the IV for block encryption of records from the peer. For
+        // AEAD ciphers this is the implicit nonce salt.
         const coder::ByteArray& getIV() const;
+        // Get the key for block encryption of records sent to the peer.
+        const coder::ByteArray& getLocalKey() const;
+        // Get the IV for block encryption of records sent to the peer.
+        // For AEAD ciphers this is the implicit nonce salt.
+        const coder::ByteArray& getLocalIV() const;
         // Gets the connection end entity.
         ConnectionEnd getEntity() const;
         // Returns the HMAC algorithm.
         MACAlgorithm getHMAC() const;
         // Return the initialization state.
         bool getInitialized() const;
+        // Get the key exchange the cipher suite calls for.
+        KeyExchangeAlgorithm getKeyExchangeAlgorithm() const;
         // Get the HMAC key length.
         uint32_t getMacKeyLength() const;
         // Get the master secret.
@@ -65,6 +81,8 @@ class ConnectionState {
 #endif
         // Increment the sequence number.
         void incrementSequence();
+        // Generate the write keys from a resumed session's master secret.
+        void resumeKeys(const coder::ByteArray& master);
 #ifdef _TLS_THREAD_LOCAL_
         // Promotes the pending read state to current and
         // initializes a new pending state.
@@ -84,6 +102,8 @@ class ConnectionState {
         void setCipherAlgorithm(BulkCipherAlgorithm alg);
         // Sets the cipher mode.
         void setCipherType(CipherType type);
+        // Sets the cipher suite and the security parameters it implies.
+        void setCipherSuite(CipherSuite suite);
         // Sets the client random value for signatures.
         void setClientRandom(const coder::ByteArray& rnd);
         // Sets the encryption key length.
@@ -92,15 +112,25 @@ class ConnectionState {
         void setEntity(ConnectionEnd end);
         // Sets the MAC algorithm.
         void setHMAC(MACAlgorithm m);
+        // Sets the pseudorandom algorithm.
+        void setPRF(PRFAlgorithm alg);
         // Indicate the the state is initialized.
         void setInitialized();
         // Sets the server random value for signatures.
         void setServerRandom(const coder::ByteArray& rnd);
 
+    private:
+        // Create the AEAD block cipher for the current keys.
+        void createAEADCipher();
+        // Generate the write keys from the master secret.
+        void generateKeyBlock();
+
     private:
         bool initialized;
         ConnectionEnd entity;
-        PRFAlgorithm prf;               // Fixed value. Cannot be set.
+        PRFAlgorithm prf;               // SHA-256 unless the suite says otherwise.
+        CipherSuite suite;
+        KeyExchangeAlgorithm keyExchange;
         BulkCipherAlgorithm cipher;
         CipherType mode;
         MACAlgorithm mac;
@@ -124,7 +154,9 @@ class ConnectionState {
         coder::ByteArray clientWriteIV; 
         coder::ByteArray serverWriteIV; 
         int64_t sequenceNumber;
-
+        // Allocated once per key set and reused for every record. The
+        // key is passed per call, so no key schedule is cached.
+        CK::Cipher *aeadCipher;
 
 #ifdef _TLS_THREAD_LOCAL_
         /*
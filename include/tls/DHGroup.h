@@ -0,0 +1,54 @@
+#ifndef DHGROUP_H_INCLUDED
+#define DHGROUP_H_INCLUDED
+
+#include "coder/ByteArray.h"
+#include "CryptoKitty-C/data/BigInteger.h"
+
+namespace CKTLS {
+
+/*
+ * Fixed finite field Diffie-Hellman group. The wire encoding of the
+ * group parameters is computed once.
+ */
+class DHGroup {
+
+    private:
+        DHGroup(const uint8_t *prime, unsigned length, unsigned exponentBits);
+
+    public:
+        ~DHGroup();
+
+    private:
+        DHGroup(const DHGroup& other);
+        DHGroup& operator= (const DHGroup& other);
+
+    public:
+        // RFC 7919 groups.
+        static const DHGroup& ffdhe2048();
+        static const DHGroup& ffdhe3072();
+        // The RFC 7919 group with these parameters, or null.
+        static const DHGroup *find(const CK::BigInteger& p,
+                                                const CK::BigInteger& g);
+
+    public:
+        // Encoded dh_p and dh_g.
+        const coder::ByteArray& getEncodedParams() const;
+        // Private exponent size.
+        unsigned getExponentBits() const;
+        const CK::BigInteger& getGenerator() const;
+        const CK::BigInteger& getModulus() const;
+        // True if 1 < y < p-1.
+        bool validPublicKey(const CK::BigInteger& y) const;
+
+    private:
+        CK::BigInteger p;
+        CK::BigInteger g;
+        coder::ByteArray prime;     // Big endian p.
+        coder::ByteArray params;
+        unsigned exponentBits;
+
+};
+
+}
+
+#endif  // DHGROUP_H_INCLUDED
@@ -0,0 +1,68 @@
+#ifndef DHKEYPOOL_H_INCLUDED
+#define DHKEYPOOL_H_INCLUDED
+
+#include "KeyPool.h"
+#include "CryptoKitty-C/data/BigInteger.h"
+#include <atomic>
+#include <deque>
+
+namespace CKTLS {
+
+class DHGroup;
+
+/*
+ * An ephemeral Diffie-Hellman key pair, x and g^x mod p.
+ */
+struct DHKey {
+    CK::BigInteger secret;
+    CK::BigInteger publicKey;
+};
+
+/*
+ * Pool of ready ephemeral key pairs for one DH group. Refill threads
+ * keep the pool topped up to the configured depth, so handshakes
+ * don't pay for the modular exponentiation. A handshake that finds
+ * the pool empty generates its own key pair.
+ */
+class DHKeyPool : public KeyPool {
+
+    public:
+        DHKeyPool(const DHGroup& group, unsigned depth = DEFAULT_DEPTH,
+                                    unsigned threads = DEFAULT_THREADS);
+        ~DHKeyPool();
+
+    private:
+        DHKeyPool(const DHKeyPool& other);
+        DHKeyPool& operator= (const DHKeyPool& other);
+
+    public:
+        const DHGroup& getGroup() const { return group; }
+        // Number of pops that found the pool empty.
+        uint64_t getMisses() const;
+        // Take a key pair.
+        DHKey pop();
+
+    public:
+        static const unsigned DEFAULT_DEPTH;
+        static const unsigned DEFAULT_THREADS;
+
+    protected:
+        void abandon(unsigned index);
+        bool claim(unsigned& index);
+        void produce(unsigned index);
+
+    private:
+        DHKey generate() const;
+
+    private:
+        const DHGroup& group;
+        unsigned depth;
+        std::deque<DHKey> keys;
+        unsigned pending;           // Key pairs being generated.
+        std::atomic<uint64_t> misses;
+
+};
+
+}
+
+#endif  // DHKEYPOOL_H_INCLUDED
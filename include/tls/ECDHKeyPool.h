@@ -0,0 +1,80 @@
+#ifndef ECDHKEYPOOL_H_INCLUDED
+#define ECDHKEYPOOL_H_INCLUDED
+
+#include "KeyPool.h"
+#include "TLSConstants.h"
+#include "coder/ByteArray.h"
+#include <atomic>
+#include <deque>
+
+namespace CK {
+    class ECDHKeyExchange;
+}
+
+namespace CKTLS {
+
+/*
+ * An ephemeral ECDH key pair. The receiver owns the exchange and
+ * must delete it after computing the shared secret.
+ */
+struct ECDHKey {
+    CK::ECDHKeyExchange *exchange;
+    coder::ByteArray publicKey;
+};
+
+/*
+ * Pool of ready ephemeral ECDH key pairs for secp256r1 and
+ * secp384r1. Refill threads keep each curve topped up to the
+ * configured depth, so handshakes don't pay for the scalar
+ * multiplication. A handshake that finds the pool empty generates
+ * its own key pair.
+ */
+class ECDHKeyPool : public KeyPool {
+
+    public:
+        ECDHKeyPool(unsigned depth = DEFAULT_DEPTH,
+                                    unsigned threads = DEFAULT_THREADS);
+        ~ECDHKeyPool();
+
+    private:
+        ECDHKeyPool(const ECDHKeyPool& other);
+        ECDHKeyPool& operator= (const ECDHKeyPool& other);
+
+    public:
+        // Number of pops that found the pool empty.
+        uint64_t getMisses() const;
+        // Take a key pair for the curve.
+        ECDHKey pop(NamedCurve curve);
+
+    public:
+        static const unsigned DEFAULT_DEPTH;
+        static const unsigned DEFAULT_THREADS;
+
+    private:
+        struct CurvePool {
+            NamedCurve curve;
+            std::deque<ECDHKey> keys;
+            unsigned pending;       // Key pairs being generated.
+        };
+
+    protected:
+        void abandon(unsigned index);
+        bool claim(unsigned& index);
+        void produce(unsigned index);
+
+    private:
+        static ECDHKey generate(NamedCurve curve);
+        CurvePool& getPool(NamedCurve curve);
+
+    private:
+        static const unsigned CURVE_COUNT = 2;
+
+        unsigned depth;
+        CurvePool pools[CURVE_COUNT];
+        std::atomic<uint64_t> misses;
+
+};
+
+}
+
+#endif  // ECDHKEYPOOL_H_INCLUDED
@@ -41,6 +41,7 @@ class ExtensionManager {
         static const uint16_t CERT_TYPE;
         static const uint16_t SUPPORTED_CURVES;
         static const uint16_t POINT_FORMATS;
+        static const uint16_t SESSION_TICKET;
 
     private:
         typedef std::map<uint32_t, Extension> ExtensionMap;
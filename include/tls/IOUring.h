@@ -0,0 +1,72 @@
+#ifndef IOURING_H_INCLUDED
+#define IOURING_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <linux/io_uring.h>
+
+namespace CKTLS {
+
+/*
+ * Minimal io_uring submission and completion queue pair, set up
+ * with the raw system calls. Entries are queued with getSQE() and
+ * submitted, together with a wait for completions, by one
+ * io_uring_enter in submit(). Not thread safe; each ring belongs to
+ * one thread. Linux only.
+ */
+class IOUring {
+
+    public:
+        IOUring(unsigned entries);
+        ~IOUring();
+
+    private:
+        IOUring(const IOUring& other);
+        IOUring& operator= (const IOUring& other);
+
+    public:
+        // Get a cleared submission queue entry. Submits queued entries
+        // if the queue is full. Returns null if it is still full.
+        io_uring_sqe *getSQE();
+        // Get the next completion, or null if there is none.
+        io_uring_cqe *peekCQE();
+        // Register a buffer for fixed reads and writes, buffer index 0.
+        void registerBuffer(void *base, size_t length);
+        // Release the completion returned by peekCQE().
+        void seen();
+        // Submit queued entries and wait for at least wait completions.
+        void submit(unsigned wait = 0);
+        // True if the kernel supports the operation.
+        bool supports(unsigned opcode) const;
+
+    private:
+        void probe();
+        void unmap();
+
+    private:
+        int fd;
+        unsigned entries;
+        // Submission queue.
+        void *sqRing;
+        size_t sqRingLength;
+        unsigned *sqHead;
+        unsigned *sqTail;
+        unsigned sqMask;
+        io_uring_sqe *sqes;
+        size_t sqesLength;
+        unsigned sqeTail;       // Next entry handed out.
+        // Completion queue.
+        void *cqRing;
+        size_t cqRingLength;
+        unsigned *cqHead;
+        unsigned *cqTail;
+        unsigned cqMask;
+        io_uring_cqe *cqes;
+        std::vector<bool> opcodes;  // Supported operations.
+
+};
+
+}
+
+#endif  // IOURING_H_INCLUDED
@@ -0,0 +1,51 @@
+#ifndef KERNELTLS_H_INCLUDED
+#define KERNELTLS_H_INCLUDED
+
+#include "TLSConstants.h"
+
+namespace CKTLS {
+
+class ConnectionState;
+
+/*
+ * Linux kernel TLS. Hands a current AES-GCM connection state to the
+ * kernel so that records are protected in the socket layer. Plain
+ * write() and sendfile() on the socket then produce TLS records
+ * without the data passing through user space.
+ *
+ * The kernel uses the RFC 5288 nonce, a 4 byte salt from the key
+ * block followed by an explicit 8 byte nonce in every record. States
+ * with any other nonce layout are refused, as are kernels without
+ * the tls module, and the caller keeps protecting records with
+ * CipherText. Linux only.
+ */
+class KernelTLS {
+
+    public:
+        enum Direction { transmit, receive };
+
+    private:
+        KernelTLS();
+
+    public:
+        // Hand one direction of the socket's record layer to the
+        // kernel. Returns false if the state or the kernel can't
+        // support it.
+        static bool enable(int fd, const ConnectionState& state,
+                                                    Direction direction);
+        // Send an alert on a socket with kernel transmit enabled.
+        // Returns false if the socket would block. Throws
+        // RecordException if the write fails.
+        static bool sendAlert(int fd, AlertDescription description,
+                                                    AlertLevel level);
+        // True if the state's cipher and nonce layout match the kernel's.
+        static bool supported(const ConnectionState& state);
+
+    public:
+        static const unsigned SALT_LENGTH;
+
+};
+
+}
+
+#endif  // KERNELTLS_H_INCLUDED
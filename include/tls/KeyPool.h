@@ -0,0 +1,63 @@
+#ifndef KEYPOOL_H_INCLUDED
+#define KEYPOOL_H_INCLUDED
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace CKTLS {
+
+/*
+ * Refill threads shared by the ephemeral key pools. A pool says what
+ * to generate next and stores what was generated. Generation runs
+ * without the lock held. A generation that throws is abandoned and
+ * the thread backs off before it tries again, so a failing key
+ * generator can't end the thread or spin on the lock.
+ *
+ * Derived pools call start() at the end of their constructor and
+ * stop() at the start of their destructor, so the threads never see
+ * a partly built pool.
+ */
+class KeyPool {
+
+    protected:
+        KeyPool();
+        virtual ~KeyPool();
+
+    private:
+        KeyPool(const KeyPool& other);
+        KeyPool& operator= (const KeyPool& other);
+
+    protected:
+        // Release a claimed key after its generation failed. Called with
+        // the lock held.
+        virtual void abandon(unsigned index) = 0;
+        // Choose the next key to generate and count it as pending.
+        // Returns false if the pool is full. Called with the lock held.
+        virtual bool claim(unsigned& index) = 0;
+        // Generate a claimed key and store it, taking the lock to store.
+        // Called without the lock held.
+        virtual void produce(unsigned index) = 0;
+        void start(unsigned threads);
+        void stop();
+
+    protected:
+        std::mutex lock;
+        std::condition_variable wanted;
+
+    private:
+        void refill();
+
+    private:
+        static const unsigned MIN_BACKOFF;      // Milliseconds.
+        static const unsigned MAX_BACKOFF;
+
+        bool stopping;
+        std::vector<std::thread> workers;
+
+};
+
+}
+
+#endif  // KEYPOOL_H_INCLUDED
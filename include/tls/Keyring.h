@@ -0,0 +1,75 @@
+#ifndef KEYRING_H_INCLUDED
+#define KEYRING_H_INCLUDED
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace CKTLS {
+
+class PGPCertificate;
+
+/*
+ * Server certificates loaded from a binary (not armored) keyring
+ * file. The file is a sequence of transferable public keys, see
+ * RFC 4880 Section 11.1.
+ *
+ * The file is mapped read only and certificates are parsed on first
+ * use. Without an index the keyring is scanned once for key IDs,
+ * which reads only packet headers and the primary key packets. An
+ * index written by writeIndex() lets the keyring open without
+ * scanning. An index is ignored if it is invalid, or if the keyring's
+ * size or modification time has changed since it was written.
+ *
+ * Key IDs are those of the V4 primary keys.
+ */
+class Keyring {
+
+    public:
+        typedef std::shared_ptr<PGPCertificate> CertificatePtr;
+
+    public:
+        Keyring(const std::string& path);
+        Keyring(const std::string& path, const std::string& indexPath);
+        ~Keyring();
+
+    private:
+        Keyring(const Keyring& other);
+        Keyring& operator= (const Keyring& other);
+
+    public:
+        bool contains(uint64_t keyID) const;
+        // Throws BadParameterException if the key ID isn't in the keyring.
+        CertificatePtr getCertificate(uint64_t keyID);
+        std::vector<uint64_t> getKeyIDs() const;
+        unsigned getSize() const { return entries.size(); }
+        void writeIndex(const std::string& indexPath) const;
+
+    private:
+        struct Entry {
+            uint32_t offset;
+            uint32_t length;
+            CertificatePtr cert;
+        };
+        typedef std::map<uint64_t, Entry> EntryMap;
+
+        static uint64_t getKeyID(const uint8_t *packet, unsigned length);
+        void map(const std::string& path);
+        bool readIndex(const std::string& indexPath);
+        void scan();
+
+    private:
+        const uint8_t *data;
+        size_t length;
+        uint64_t modified;          // Nanoseconds since the epoch.
+        EntryMap entries;
+        mutable std::mutex lock;
+
+};
+
+}
+
+#endif  // KEYRING_H_INCLUDED
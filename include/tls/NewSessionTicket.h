@@ -0,0 +1,42 @@
+#ifndef NEWSESSIONTICKET_H_INCLUDED
+#define NEWSESSIONTICKET_H_INCLUDED
+
+#include "HandshakeBody.h"
+
+namespace CKTLS {
+
+/*
+ * NewSessionTicket handshake message. See RFC 5077 Section 3.3.
+ */
+class NewSessionTicket : public HandshakeBody {
+
+    public:
+        NewSessionTicket();
+        ~NewSessionTicket();
+
+    private:
+        NewSessionTicket(const NewSessionTicket& other);
+        NewSessionTicket& operator= (const NewSessionTicket& other);
+
+    public:
+#ifdef _DEBUG
+        void debugOut(std::ostream& out);
+#endif
+        const coder::ByteArray& encode();
+        uint32_t getLifetimeHint() const;
+        const coder::ByteArray& getTicket() const;
+        void initState() {}
+        void initState(uint32_t lifetimeHint, const coder::ByteArray& ticket);
+
+    protected:
+        void decode();
+
+    private:
+        uint32_t lifetimeHint;      // Seconds.
+        coder::ByteArray ticket;
+
+};
+
+}
+
+#endif  // NEWSESSIONTICKET_H_INCLUDED
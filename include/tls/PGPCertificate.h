@@ -7,6 +7,9 @@
 #include "CryptoKitty-PGP/openpgp/packet/UserID.h"
 #include "CryptoKitty-PGP/openpgp/packet/UserAttribute.h"
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace CKTLS {
 
@@ -25,17 +28,34 @@ class PGPCertificate {
         PGPCertificate(const PGPCertificate& other);
         PGPCertificate& operator= (const PGPCertificate& other);
 
+    public:
+        typedef std::shared_ptr<const coder::ByteArray> Body;
+
     public:
         void addUserID(const CKPGP::UserID& uid, const CKPGP::Signature& sig);
         coder::ByteArray encode();
         void encode(std::ostream& out);
+        // Certificate message body for a key ID and descriptor type,
+        // as stored by setBody(). Null if there is none.
+        Body getBody(uint64_t keyID, unsigned type) const;
+        // V4 fingerprint of the primary key. See RFC 4880 Section 12.2.
+        coder::ByteArray getFingerprint() const;
         CKPGP::PublicKey *getPublicKey();
+        // Length, header included, of the packet starting at data.
+        static unsigned packetLength(const uint8_t *data, unsigned available);
+        // Keep an encoded Certificate message body with the certificate,
+        // so handshakes can share it. Bodies are dropped when the
+        // certificate is changed, assigned or destroyed, and are not
+        // copied.
+        void setBody(uint64_t keyID, unsigned type, Body body) const;
         void setPublicKey(CKPGP::PublicKey *pk);
 
     private:
+        void clearBodies();
         void decode(const coder::ByteArray& encoded);
         void decode(std::istream& in);
         uint32_t decodePGPLength(std::istream& in, coder::ByteArray& lBytes) const;
+        unsigned packetLength(const coder::ByteArray& encoded, unsigned index) const;
 
     private:
         CKPGP::PublicKey *publicKey;
@@ -73,6 +93,20 @@ class PGPCertificate {
 
         SignatureList revocation;
 
+        struct SharedBody {
+            uint64_t keyID;
+            unsigned type;
+            Body body;
+        };
+        mutable std::mutex bodyLock;
+        mutable std::vector<SharedBody> bodies;
+
+    private:
+        CKPGP::Packet *decodePacket(const coder::ByteArray& encoded,
+                                                    unsigned& index) const;
+        CKPGP::Packet *decodeSignatures(const coder::ByteArray& encoded,
+                                    unsigned& index, SignatureList& sigs) const;
+
 };
 
 }
@@ -0,0 +1,49 @@
+#ifndef PRF_H_INCLUDED
+#define PRF_H_INCLUDED
+
+#include "TLSConstants.h"
+#include "coder/ByteArray.h"
+
+namespace CK {
+    class Digest;
+}
+
+namespace CKTLS {
+
+/*
+ * TLS 1.2 pseudorandom function. See RFC 5246 Section 5.
+ * The padded HMAC keys are computed once per secret and the
+ * output is written directly to a caller supplied buffer.
+ */
+class PRF {
+
+    public:
+        PRF(PRFAlgorithm alg);
+        ~PRF();
+
+    private:
+        PRF(const PRF& other);
+        PRF& operator= (const PRF& other);
+
+    public:
+        // Generate length bytes of PRF(secret, label, seed) to output.
+        void generate(const char *label, const coder::ByteArray& seed,
+                                        uint8_t *output, unsigned length);
+        // Set the PRF secret.
+        void setSecret(const coder::ByteArray& secret);
+
+    private:
+        coder::ByteArray hmac(const coder::ByteArray& a,
+                                        const coder::ByteArray& b);
+
+    private:
+        CK::Digest *digest;
+        unsigned blockSize;
+        coder::ByteArray innerPad;  // K XOR ipad
+        coder::ByteArray outerPad;  // K XOR opad
+
+};
+
+}
+
+#endif  // PRF_H_INCLUDED
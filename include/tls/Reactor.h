@@ -0,0 +1,95 @@
+#ifndef REACTOR_H_INCLUDED
+#define REACTOR_H_INCLUDED
+
+#if __cplusplus >= 202002L
+
+#include "Task.h"
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace CKTLS {
+
+/*
+ * Single threaded coroutine executor over epoll. Coroutines wait for
+ * socket readiness with co_await reactor.readable(fd) or writable(fd)
+ * and are resumed by run() on the reactor's thread. A waiting
+ * coroutine holds no thread, only its frame and its part of the
+ * descriptor's oneshot epoll registration. One coroutine can wait to
+ * read a descriptor while another waits to write it. Run one reactor
+ * per thread to use more cores.
+ *
+ * post() and spawn() can be called from any thread, so work finished
+ * elsewhere, such as a signature from AsyncSigner, resumes its
+ * coroutine on the reactor. Linux only.
+ */
+class Reactor {
+
+    public:
+        class Readiness {
+            public:
+                Readiness(Reactor& r, int f, bool w)
+                : reactor(r), fd(f), write(w) {}
+                bool await_ready() const { return false; }
+                void await_suspend(std::coroutine_handle<> h) {
+                    reactor.watch(fd, write, h);
+                }
+                void await_resume() const {}
+            private:
+                Reactor& reactor;
+                int fd;
+                bool write;
+        };
+
+    public:
+        Reactor();
+        ~Reactor();
+
+    private:
+        Reactor(const Reactor& other);
+        Reactor& operator= (const Reactor& other);
+
+    public:
+        // Resume a coroutine on the reactor thread.
+        void post(std::coroutine_handle<> handle);
+        // Wait until the descriptor can be read, or has an error.
+        Readiness readable(int fd);
+        // Resume coroutines until stop() is called.
+        void run();
+        // Start a task on the reactor thread. The task owns itself and
+        // exceptions that escape it are dropped.
+        void spawn(Task<void> task);
+        // Make run() return. Waiting coroutines are not resumed.
+        void stop();
+        // Wait until the descriptor can be written, or has an error.
+        Readiness writable(int fd);
+
+    private:
+        // Coroutines waiting on one descriptor.
+        struct Waiters {
+            std::coroutine_handle<> reader;
+            std::coroutine_handle<> writer;
+        };
+
+        void arm(int fd, const Waiters& waiters);
+        void dispatch(int fd, uint32_t events);
+        void watch(int fd, bool write, std::coroutine_handle<> handle);
+
+    private:
+        int epollfd;
+        int postfd;
+        std::atomic<bool> stopping;
+        std::mutex lock;
+        std::vector<std::coroutine_handle<> > posted;
+        std::unordered_map<int, Waiters> waiting;
+
+};
+
+}
+
+#endif  // __cplusplus >= 202002L
+
+#endif  // REACTOR_H_INCLUDED
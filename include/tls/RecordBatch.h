@@ -0,0 +1,59 @@
+#ifndef RECORDBATCH_H_INCLUDED
+#define RECORDBATCH_H_INCLUDED
+
+#include "RecordProtocol.h"
+
+namespace CKTLS {
+
+/*
+ * Accumulates encoded records in one contiguous buffer so that a
+ * whole flight can be sent with a single write. The buffer is
+ * allocated when the first record is appended, so a batch that is
+ * never written to costs no buffer.
+ */
+class RecordBatch {
+
+    public:
+        RecordBatch(unsigned capacity = DEFAULT_CAPACITY);
+        ~RecordBatch();
+
+    private:
+        RecordBatch(const RecordBatch& other);
+        RecordBatch& operator= (const RecordBatch& other);
+
+    public:
+        // Encode a record onto the end of the batch.
+        void append(RecordProtocol& record);
+        // Append bytes that need no encoding.
+        void append(const uint8_t *data, unsigned length);
+        // Discard all batched records.
+        void clear();
+        // Write the batch to a file descriptor. Returns true when
+        // everything has been written.
+        bool flush(int fd);
+        // Unwritten batch data.
+        const uint8_t *getData() const;
+        unsigned getLength() const;
+        // Number of records appended since the last clear.
+        unsigned getRecordCount() const;
+        // Mark bytes as written by the caller's own I/O.
+        void written(unsigned count);
+
+    public:
+        static const unsigned DEFAULT_CAPACITY;
+
+    private:
+        void reserve(unsigned length);
+
+    private:
+        uint8_t *buffer;
+        unsigned capacity;      // Initial size until allocated.
+        unsigned start;         // First unwritten byte.
+        unsigned end;           // One past the last encoded byte.
+        unsigned records;
+
+};
+
+}
+
+#endif  // RECORDBATCH_H_INCLUDED
@@ -6,6 +6,14 @@
 
 namespace CKTLS {
 
+/*
+ * A view of bytes held in a caller owned buffer.
+ */
+struct RecordView {
+    uint8_t *data;
+    unsigned length;
+};
+
 class RecordProtocol {
 
     protected:
@@ -23,6 +31,9 @@ class RecordProtocol {
         virtual void decodeRecord();
         virtual ContentType decodePreamble(const coder::ByteArray& pre);
         virtual const coder::ByteArray& encodeRecord();
+        // Encode the record directly into the caller's buffer. Returns
+        // the number of bytes written.
+        unsigned encodeRecord(uint8_t *buffer, unsigned length);
         const coder::ByteArray& getFragment() const;
         uint16_t getFragmentLength() const;
         uint8_t getRecordMajorVersion() const;
@@ -33,6 +44,10 @@ class RecordProtocol {
     protected:
         virtual void decode()=0;
         virtual void encode()=0;
+        // Encode the fragment into the buffer. Returns the fragment length.
+        virtual unsigned encodeFragment(uint8_t *buffer, unsigned length);
+        static unsigned copyOut(const coder::ByteArray& src, uint8_t *buffer,
+                                                            unsigned length);
 
     protected:
         ContentType content;
@@ -44,6 +59,7 @@ class RecordProtocol {
 
         static const uint8_t MAJOR;
         static const uint8_t MINOR;
+        static const unsigned HEADER_LENGTH;
 
 };
 
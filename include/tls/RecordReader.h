@@ -0,0 +1,54 @@
+#ifndef RECORDREADER_H_INCLUDED
+#define RECORDREADER_H_INCLUDED
+
+#include "RecordProtocol.h"
+
+namespace CKTLS {
+
+/*
+ * Frames TLS records from a byte stream. Socket reads of any size
+ * go directly into the reader's buffer and complete records are
+ * handed back as views of that buffer. A view is valid until the
+ * next call to getReadBuffer() or append().
+ */
+class RecordReader {
+
+    public:
+        RecordReader(unsigned capacity = DEFAULT_CAPACITY);
+        ~RecordReader();
+
+    private:
+        RecordReader(const RecordReader& other);
+        RecordReader& operator= (const RecordReader& other);
+
+    public:
+        // Copy bytes into the reader. Returns the number of bytes accepted.
+        unsigned append(const uint8_t *data, unsigned length);
+        // Commit bytes written into the read buffer.
+        void commit(unsigned count);
+        // Number of bytes buffered and not yet returned as records.
+        unsigned getBuffered() const;
+        // Get space for the next socket read.
+        uint8_t *getReadBuffer(unsigned& available);
+        // Get the next complete record, including its header. Returns
+        // false if more input is needed.
+        bool nextRecord(RecordView& record);
+
+    public:
+        static const unsigned MAX_FRAGMENT_LENGTH;
+        static const unsigned DEFAULT_CAPACITY;
+
+    private:
+        void compact();
+
+    private:
+        uint8_t *buffer;
+        unsigned capacity;
+        unsigned start;         // First byte not yet returned.
+        unsigned end;           // One past the last byte buffered.
+
+};
+
+}
+
+#endif  // RECORDREADER_H_INCLUDED
@@ -3,6 +3,7 @@
 
 #include "HandshakeBody.h"
 #include "PGPCertificate.h"
+#include "CertificateCache.h"
 
 namespace CK {
     class RSAPrivateKey;
@@ -10,6 +11,17 @@ namespace CK {
 
 namespace CKTLS {
 
+/*
+ * The encoded message body is built once per certificate, key ID and
+ * descriptor type and shared by every handshake that sends it. The
+ * body is kept on the PGPCertificate, so it goes away with the
+ * certificate.
+ *
+ * A server may send only the certificate's fingerprint to clients
+ * that have cached the certificate. Clients look fingerprints up in
+ * the certificate cache, which also collects certificates received
+ * in full.
+ */
 class ServerCertificate : public HandshakeBody {
 
     public:
@@ -30,22 +42,34 @@ class ServerCertificate : public HandshakeBody {
 #endif
         const coder::ByteArray& encode();
         static CK::RSAPrivateKey *getRSAPrivateKey();
-        static CK::RSAPublicKey *getRSAPublicKey();
+        // The decoded certificate.
+        CertificateCache::CertificatePtr getReceived() const { return received; }
         void initState();
         void setKeyID(uint64_t id);
         void setCertificate(PGPCertificate *c);
+        // Set the client's certificate cache.
+        static void setCertificateCache(CertificateCache *cache);
+        // Send the full certificate or only its fingerprint.
+        void setDescriptorType(OpenPGPCertDescriptorType t);
         static void setRSAPrivateKey(CK::RSAPrivateKey *pk);
 
     protected:
         void decode();
 
+    private:
+        typedef PGPCertificate::Body Encoding;
+        static Encoding getEncoding(PGPCertificate *cert, uint64_t keyID,
+                                            OpenPGPCertDescriptorType type);
+
     private:
         PGPCertificate *cert;
+        CertificateCache::CertificatePtr received;
         uint64_t keyID;
         OpenPGPCertDescriptorType type;
+        Encoding body;
 
         static CK::RSAPrivateKey *rsaPrivateKey;
-        static CK::RSAPublicKey *rsaPublicKey;
+        static CertificateCache *certificateCache;
 
 };
 
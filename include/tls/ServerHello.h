@@ -20,10 +20,14 @@ class ServerHello : public HandshakeBody {
 #ifdef _DEBUG
         void debugOut(std::ostream& out);
 #endif
+        void addExtension(const Extension& ext);
         const coder::ByteArray& encode();
         CipherSuite getCipherSuite() const;
+        bool getExtension(uint16_t etype, Extension& ex) const;
         const coder::ByteArray& getRandom() const;
+        const coder::ByteArray& getSessionID() const;
         void initState();
+        void setSessionID(const coder::ByteArray& id);
         void initState(const ClientHello& hello);
 
     protected:
@@ -6,11 +6,12 @@
 #include "CryptoKitty-C/keys/ECDHKeyExchange.h"
 
 namespace CK {
-    class RSAPrivateKey;
+    class RSAPublicKey;
 }
 
 namespace CKTLS {
 
+class DHGroup;
 #ifndef _TLS_THREAD_LOCAL_
     class StateContainer;
 #endif
@@ -36,13 +37,22 @@ class ServerKeyExchange : public HandshakeBody {
         const CK::BigInteger& getDHModulus() const;
         const CK::BigInteger& getDHPublicKey() const;
         const coder::ByteArray& getECPublicKey() const;
+        // Get the data to sign, for signing off the connection's thread.
+        coder::ByteArray getSignedData();
         void initState() {}
         void initState(NamedCurve curve, const coder::ByteArray& pk);
         void initState(const CK::ECDHKeyExchange::CurveParams& p,
                                                 const coder::ByteArray& pk);
         void initState(const CK::BigInteger& g, const CK::BigInteger& p,
                                                 const CK::BigInteger& pk);
-        static void setAlgorithm(KeyExchangeAlgorithm alg);
+        void initState(const DHGroup& group, const CK::BigInteger& pk);
+        // Set a signature made from getSignedData().
+        void setSignature(const coder::ByteArray& sig);
+        // RSA SHA-256 signature with the server's private key.
+        static coder::ByteArray sign(const coder::ByteArray& data);
+        // Check the decoded signature with the peer certificate's key.
+        // Throws EncodingException if it doesn't verify.
+        void verify(const CK::RSAPublicKey& key);
 
     protected:
         void decode();
@@ -50,18 +60,22 @@ class ServerKeyExchange : public HandshakeBody {
     private:
         void decodeDH();
         void decodeECDH();
-        void encodeDH();
-        void encodeECDH();
+        void decodeSignature(uint32_t index);
+        coder::ByteArray encodeDH() const;
+        coder::ByteArray encodeECDH() const;
+        coder::ByteArray encodeParams();
 
     private:
-        static KeyExchangeAlgorithm algorithm;
-        CK::RSAPrivateKey *rsaKey;
         // ServerDHParams
+        const DHGroup *dhGroup; // Fixed group, if any.
         CK::BigInteger dP;      // D-H prime modulus.
         CK::BigInteger dG;      // D-H generator.
         CK::BigInteger dYs;     // D-H public value.
         coder::ByteArray clientRandom;
         coder::ByteArray serverRandom;
+        coder::ByteArray signature;
+        HashAlgorithm hashAlgorithm;    // Of a decoded signature.
+        coder::ByteArray signedData;    // Decoded, for verify().
         // EC parameters
         ECCurveType curveType;
         struct ECCurve {
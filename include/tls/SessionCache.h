@@ -0,0 +1,112 @@
+#ifndef SESSIONCACHE_H_INCLUDED
+#define SESSIONCACHE_H_INCLUDED
+
+#include "TLSConstants.h"
+#include "coder/ByteArray.h"
+#include <atomic>
+#include <ctime>
+#include <mutex>
+
+namespace CKTLS {
+
+class ConnectionState;
+
+/*
+ * A resumable session. See RFC 5246 Section 7.3.
+ */
+struct Session {
+    coder::ByteArray masterSecret;
+    CipherSuite suite;
+    time_t created;
+};
+
+/*
+ * Server side session ID cache. The cache is split into shards
+ * selected by a keyed hash of the session ID. Each shard is a set
+ * associative table of fixed size slots. Lookups are lock free;
+ * each slot is guarded by a sequence count that readers check
+ * around their copy. Stores and removals take the shard lock, so
+ * writers only contend within a shard. The oldest session in a
+ * bucket is evicted when the bucket is full, and sessions expire
+ * after a fixed lifetime.
+ */
+class SessionCache {
+
+    public:
+        SessionCache(unsigned maxSessions = DEFAULT_SIZE,
+                                    unsigned lifetime = DEFAULT_LIFETIME,
+                                    unsigned shards = DEFAULT_SHARDS);
+        ~SessionCache();
+
+    private:
+        SessionCache(const SessionCache& other);
+        SessionCache& operator= (const SessionCache& other);
+
+    public:
+        // Look up a session. Returns false if it is not cached or has expired.
+        bool find(const coder::ByteArray& id, Session& session);
+        uint64_t getEvictions() const;
+        uint64_t getHits() const;
+        uint64_t getMisses() const;
+        unsigned getShardCount() const { return shardCount; }
+        // Generate a new random session ID.
+        static coder::ByteArray newSessionID();
+        // Remove a session, e.g. after a fatal alert.
+        void remove(const coder::ByteArray& id);
+        // Cache the master secret and suite of a negotiated state.
+        void store(const coder::ByteArray& id, const ConnectionState& state);
+
+    public:
+        static const unsigned DEFAULT_SIZE;
+        static const unsigned DEFAULT_LIFETIME;     // Seconds.
+        static const unsigned DEFAULT_SHARDS;
+        static const unsigned WAYS;                 // Slots per bucket.
+
+    private:
+        /*
+         * Slot layout, in 64 bit words. Word 0 is the creation time,
+         * zero if the slot is empty. Word 1 holds the ID length and
+         * the cipher suite. Words 2 - 5 hold the ID and words 6 - 11
+         * the master secret.
+         */
+        static const unsigned SLOT_WORDS = 12;
+        struct Slot {
+            std::atomic<uint32_t> sequence;
+            std::atomic<uint64_t> words[SLOT_WORDS];
+        };
+
+        struct Shard {
+            std::mutex lock;
+            Slot *slots;
+            std::atomic<uint64_t> hits;
+            std::atomic<uint64_t> misses;
+            std::atomic<uint64_t> evictions;
+            char pad[64];   // Keep shard counters off shared cache lines.
+        };
+
+        // Slot words for a session ID.
+        struct Key {
+            uint64_t meta;
+            uint64_t id[4];
+        };
+
+    private:
+        Slot *bucket(const Key& key, Shard*& shard);
+        uint64_t hash(const Key& key) const;
+        static void makeKey(const coder::ByteArray& id, Key& key);
+        static bool matches(const uint64_t *words, const Key& key);
+        static void read(Slot& slot, uint64_t *words);
+        static void write(Slot& slot, const uint64_t *words);
+
+    private:
+        unsigned shardCount;
+        unsigned bucketCount;       // Per shard.
+        time_t lifetime;
+        uint64_t seed;
+        Shard *shards;
+
+};
+
+}
+
+#endif  // SESSIONCACHE_H_INCLUDED
@@ -0,0 +1,201 @@
+#ifndef TLSCONNECTION_H_INCLUDED
+#define TLSCONNECTION_H_INCLUDED
+
+#ifndef _TLS_THREAD_LOCAL_
+
+#include "CertificateCache.h"
+#include "ConnectionState.h"
+#include "RecordBatch.h"
+#include "RecordReader.h"
+#include "CryptoKitty-C/data/BigInteger.h"
+
+namespace CK {
+    class ECDHKeyExchange;
+}
+
+namespace CKTLS {
+
+class DHGroup;
+class DHKeyPool;
+class ECDHKeyPool;
+class HandshakeRecord;
+class PGPCertificate;
+class SessionCache;
+class TicketKeyRing;
+
+/*
+ * Drives one client or server connection through the handshake and
+ * then carries application data. The connection never does I/O of
+ * its own. Bytes received from the peer are fed in and the bytes to
+ * send are taken out, so any number of connections can be run from
+ * a non-blocking event loop.
+ *
+ * handshake(), read() and write() never block. They report what the
+ * connection needs next. Output may be pending after any call and
+ * should be sent before waiting for input.
+ *
+ * The key exchange follows the negotiated cipher suite. ECDHE uses
+ * secp256r1. Clients accept only the RFC 7919 D-H groups, and both ends
+ * reject D-H public values outside 1 < Y < p-1. Servers resume sessions
+ * from the session cache and ticket key ring, if set.
+ *
+ * An established connection can hand its transmit side to Linux
+ * kernel TLS with offload(). Written data is then queued as plaintext
+ * and the kernel encrypts it, so files can also be sent on the socket
+ * with sendfile(). The close_notify, which needs its record type set,
+ * is then sent on the socket by the connection once output drains.
+ */
+class TLSConnection {
+
+    public:
+        enum Status { complete, want_read, want_write, want_signature, closed };
+
+    public:
+        TLSConnection(ConnectionEnd end);
+        ~TLSConnection();
+
+    private:
+        TLSConnection(const TLSConnection& other);
+        TLSConnection& operator= (const TLSConnection& other);
+
+    public:
+        // Queue a close_notify alert.
+        void close();
+        // Copy bytes received from the peer. Returns the number accepted.
+        unsigned feed(const uint8_t *data, unsigned length);
+        // Commit bytes read directly into the read buffer.
+        void commitRead(unsigned count);
+        // Move pending output into a send buffer, encoding application
+        // data straight into it when encoding is deferred. Returns the
+        // number of bytes moved, zero if there is no output.
+        unsigned encodeOutput(uint8_t *buffer, unsigned length);
+        // Write pending output to a descriptor. Returns true when all of
+        // it, and any kernel close_notify, has been written.
+        bool flush(int fd);
+        // Resumable session, once the handshake is complete.
+        const coder::ByteArray& getMasterSecret() const { return masterSecret; }
+        const coder::ByteArray& getSessionID() const { return sessionID; }
+        const coder::ByteArray& getTicket() const { return ticket; }
+        // The ServerKeyExchange data to sign while handshake() returns
+        // want_signature.
+        coder::ByteArray getSignatureData();
+        // Space for the next socket read.
+        uint8_t *getReadBuffer(unsigned& available);
+        // Pending output. Doesn't include application data waiting for
+        // encodeOutput().
+        const uint8_t *getWriteData(unsigned& length) const;
+        // Advance the handshake as far as the buffered input allows.
+        Status handshake();
+        bool isEstablished() const { return state == established; }
+        bool isOffloaded() const { return kernelFD >= 0; }
+        bool isResumed() const { return resumed; }
+        // Hand the transmit side to kernel TLS on the connection's socket.
+        // Only once established with no output pending. Returns false,
+        // leaving records to CipherText, if the kernel or the negotiated
+        // cipher state can't support it.
+        bool offload(int fd);
+        // Get the plaintext of the next application data record. The
+        // view is valid until more input is fed in.
+        Status read(RecordView& plaintext);
+        // Keep written application data as plaintext until
+        // encodeOutput() encodes it into the caller's buffer.
+        void setDeferredEncoding(bool defer) { deferEncoding = defer; }
+        // Server only. Have handshake() return want_signature instead of
+        // signing the ServerKeyExchange, so it can be signed elsewhere.
+        void setDeferredSigning(bool defer) { deferSigning = defer; }
+        // Client only. Offer to resume a session from an earlier
+        // connection, by ticket if there is one, otherwise by ID.
+        void setSession(const coder::ByteArray& id, const coder::ByteArray& master,
+                                                const coder::ByteArray& ticket);
+        // Continue the server's flight with a signature of
+        // getSignatureData().
+        void setSignature(const coder::ByteArray& signature);
+        // Queue application data. Returns want_write.
+        Status write(const uint8_t *data, unsigned length);
+        // Mark pending output as sent by the caller's own I/O.
+        void written(unsigned count);
+
+    public:
+        // Server configuration.
+        static void setCertificate(PGPCertificate *cert, uint64_t keyID = 0);
+        // Optional key pair pools. Without them key pairs are generated
+        // by each handshake, and DHE uses the ffdhe2048 group.
+        static void setDHKeyPool(DHKeyPool *pool);
+        static void setECDHKeyPool(ECDHKeyPool *pool);
+        static void setSessionCache(SessionCache *cache);
+        static void setTicketKeyRing(TicketKeyRing *ring);
+
+    private:
+        enum HandshakeState { client_start, client_server_hello,
+                client_certificate, client_server_key_exchange,
+                client_server_hello_done, client_new_session_ticket,
+                server_client_hello, server_signing, server_client_key_exchange,
+                peer_change_cipher_spec, peer_finished, established,
+                shut_down };
+
+        void clientHello();
+        void deriveKeys(const coder::ByteArray& premaster);
+        void negotiate(CipherSuite suite);
+        void queueRecords(const uint8_t *data, unsigned length);
+        bool receive(RecordProtocol& record);
+        bool receive(HandshakeRecord& record, HandshakeType type);
+        bool receiveClientHello();
+        bool receiveClientKeyExchange();
+        bool receiveFinished();
+        bool receiveServerHello();
+        bool receiveServerHelloDone();
+        bool receiveServerKeyExchange();
+        void resumeKeys(const coder::ByteArray& master);
+        void send(RecordProtocol& record);
+        void sendAlert(AlertDescription description, AlertLevel level);
+        void sendKernelNotify();
+        void sendChangeCipherSpec();
+        void sendFinished();
+        void sendKeyExchange();
+        void serverFlight();
+        bool step();
+
+    private:
+        ConnectionEnd end;
+        HandshakeState state;
+        StateContainer holder;
+        RecordReader reader;
+        RecordBatch batch;
+        RecordBatch plaintext;          // Application data to encode.
+        coder::ByteArray transcript;    // Handshake messages so far.
+        coder::ByteArray clientRandom;
+        coder::ByteArray serverRandom;
+        coder::ByteArray sessionID;
+        coder::ByteArray masterSecret;
+        coder::ByteArray ticket;
+        bool resumed;
+        bool ticketExpected;            // A NewSessionTicket will be sent.
+        bool deferSigning;
+        bool deferEncoding;
+        KeyExchangeAlgorithm exchangeAlgorithm;
+        int kernelFD;                   // Socket with kernel TLS transmit.
+        bool notifyPending;             // Kernel close_notify after the output.
+        // Ephemeral keys.
+        const DHGroup *dhGroup;
+        CK::BigInteger dhSecret;
+        CK::ECDHKeyExchange *ecdh;
+        coder::ByteArray premaster;
+        // Client's, sent after ServerHelloDone, or server's while signing.
+        HandshakeRecord *keyExchange;
+        // Client only. Holds the key that verifies the ServerKeyExchange.
+        CertificateCache::CertificatePtr peerCert;
+
+        static PGPCertificate *serverCert;
+        static uint64_t keyID;
+        static DHKeyPool *dhPool;
+        static ECDHKeyPool *ecdhPool;
+        static SessionCache *sessionCache;
+        static TicketKeyRing *ticketKeys;
+
+};
+
+}
+
+#endif  // _TLS_THREAD_LOCAL_
+
+#endif  // TLSCONNECTION_H_INCLUDED
@@ -8,7 +8,7 @@ namespace CKTLS {
 enum ContentType { change_cipher_spec=20, alert=21, handshake=22, application_data=23 };
 
 enum HandshakeType { hello_request=0, client_hello=1,
-                server_hello=2, certificate=11, server_key_exchange=12,
+                server_hello=2, new_session_ticket=4, certificate=11, server_key_exchange=12,
                 certificate_request=13, server_hello_done=14,
                 certificate_verify=15, client_key_exchange=16,
                 finished=20 };
@@ -30,7 +30,7 @@ enum AlertDescription { close_notify=0, unexpected_message=10,
 
 enum ConnectionEnd { server, client };
 
-enum PRFAlgorithm { tls_prf_sha256 };
+enum PRFAlgorithm { tls_prf_sha256, tls_prf_sha384 };
 
 enum BulkCipherAlgorithm { bca_null, rc4, tdes, aes };
 
@@ -0,0 +1,155 @@
+#ifndef TLSSERVER_H_INCLUDED
+#define TLSSERVER_H_INCLUDED
+
+#ifndef _TLS_THREAD_LOCAL_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <set>
+#include <thread>
+#include <vector>
+#include <linux/time_types.h>
+
+namespace CKTLS {
+
+class IOUring;
+class TLSConnection;
+
+/*
+ * epoll server engine. Each loop thread owns a listening socket bound
+ * to the same port with SO_REUSEPORT, so the kernel shards incoming
+ * connections across the threads. A connection stays on the thread
+ * that accepted it for its whole life and is never locked. When the
+ * process is out of descriptors, connections waiting to be accepted
+ * are closed at once with the epoll backend, and accepted after a
+ * backoff with the io_uring backend.
+ *
+ * Connections are TLSConnection state machines driven by readiness
+ * events. Decrypted application data is passed to the data callback
+ * on the connection's loop thread. The callback may write replies to
+ * the connection or close it. The engine sends whatever output is
+ * pending when the callback returns.
+ *
+ * With the io_uring backend each loop keeps a receive in flight for
+ * every connection, straight into the connection's record reader.
+ * Application data is encrypted straight into a per connection slot
+ * of a registered buffer and sent with a fixed write. The loop submits
+ * every queued operation and waits for completions in a single
+ * io_uring_enter call. Each loop has a fixed number of buffer slots,
+ * and connections accepted while they are all in use are closed. If
+ * the kernel lacks io_uring or an operation the loop uses, or the
+ * registered buffers exceed RLIMIT_MEMLOCK, the server runs on epoll.
+ *
+ * With kernel TLS set, each connection's transmit side is handed to
+ * the kernel once its handshake output has been sent, if the kernel
+ * and the negotiated cipher state allow it.
+ *
+ * Server configuration, such as the certificate and key exchange, is
+ * set on TLSConnection before the server is started. Linux only.
+ */
+class TLSServer {
+
+    public:
+        typedef std::function<void(TLSConnection& connection,
+                                const uint8_t *data, unsigned length)> DataCallback;
+        typedef std::function<void(TLSConnection& connection)> EventCallback;
+
+        enum IOBackend { epoll_io, uring_io };
+
+    public:
+        TLSServer(uint16_t port, unsigned threads = DEFAULT_THREADS,
+                                                IOBackend backend = epoll_io);
+        ~TLSServer();
+
+    private:
+        TLSServer(const TLSServer& other);
+        TLSServer& operator= (const TLSServer& other);
+
+    public:
+        // Connections currently open.
+        uint64_t getActive() const { return active.load(); }
+        // The backend in use, once started.
+        IOBackend getBackend() const { return backend; }
+        // Completed handshakes.
+        uint64_t getHandshakes() const { return handshakes.load(); }
+        // Called when a connection closes, before it is deleted.
+        void setCloseCallback(EventCallback cb) { closeCallback = cb; }
+        void setDataCallback(DataCallback cb) { dataCallback = cb; }
+        // Called when a connection completes its handshake.
+        void setEstablishedCallback(EventCallback cb) { establishedCallback = cb; }
+        // Offload record encryption to kernel TLS where possible.
+        void setKernelTLS(bool enable);
+        // Connections per loop with the io_uring backend.
+        void setMaxConnections(unsigned max);
+        // Open the listening sockets and start the loop threads.
+        void start();
+        // Stop the loop threads and close all connections.
+        void stop();
+
+    public:
+        static const unsigned DEFAULT_THREADS;
+        static const unsigned MAX_EVENTS;
+        static const unsigned DEFAULT_MAX_CONNECTIONS;
+        static const unsigned SLOT_LENGTH;
+
+    private:
+        struct Connection;
+        struct Loop {
+            int epollfd;
+            int listenfd;
+            int stopfd;
+            int sparefd;                        // Reserve, to shed connections.
+            std::thread thread;
+            std::set<Connection*> connections;
+            std::vector<Connection*> closed;    // Deleted after each batch of events.
+            // io_uring backend.
+            IOUring *ring;
+            uint8_t *buffer;                    // Registered write slots.
+            std::vector<uint8_t*> slots;        // Free slots.
+            uint64_t stopValue;
+            unsigned acceptBackoff;             // Milliseconds.
+            __kernel_timespec acceptDelay;
+        };
+
+        void accept(Loop& loop);
+        void accepted(Loop& loop, int fd);
+        void close(Loop& loop, Connection *connection);
+        void closeLoop(Loop& loop);
+        void flush(Loop& loop, Connection *connection);
+        void handle(Loop& loop, Connection *connection, uint32_t events);
+        void open(Loop& loop);
+        void openLoops();
+        void offload(Connection *connection);
+        bool process(Connection *connection);
+        void receive(Loop& loop, Connection *connection);
+        void received(Loop& loop, Connection *connection, int result);
+        void release(Loop& loop);
+        void retryAccept(Loop& loop);
+        void run(Loop& loop);
+        void runUring(Loop& loop);
+        void send(Loop& loop, Connection *connection);
+        void sent(Loop& loop, Connection *connection, int result);
+        bool shed(Loop& loop);
+        void submitAccept(Loop& loop);
+
+    private:
+        uint16_t port;
+        IOBackend backend;
+        unsigned maxConnections;
+        bool kernelTLS;
+        std::vector<Loop> loops;
+        bool running;
+        DataCallback dataCallback;
+        EventCallback establishedCallback;
+        EventCallback closeCallback;
+        std::atomic<uint64_t> active;
+        std::atomic<uint64_t> handshakes;
+
+};
+
+}
+
+#endif  // _TLS_THREAD_LOCAL_
+
+#endif  // TLSSERVER_H_INCLUDED
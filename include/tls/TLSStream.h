@@ -0,0 +1,79 @@
+#ifndef TLSSTREAM_H_INCLUDED
+#define TLSSTREAM_H_INCLUDED
+
+#if __cplusplus >= 202002L
+#ifndef _TLS_THREAD_LOCAL_
+
+#include "Reactor.h"
+#include "Task.h"
+#include "TLSConnection.h"
+
+namespace CKTLS {
+
+class AsyncSigner;
+
+/*
+ * Coroutine interface to a TLSConnection on a non-blocking socket.
+ * Operations suspend on the reactor while they wait for the peer, or
+ * for the ServerKeyExchange signature when a signer is set, so idle
+ * handshakes hold no thread.
+ *
+ *     Task<void> serve(Reactor& reactor, int fd) {
+ *         TLSStream stream(reactor, fd, server);
+ *         co_await stream.handshake();
+ *         RecordView view;
+ *         while (co_await stream.read(view)) {
+ *             co_await stream.write(view.data, view.length);
+ *         }
+ *         ::close(fd);
+ *     }
+ *     reactor.spawn(serve(reactor, fd));
+ *
+ * Operations throw RecordException on protocol or socket errors. The
+ * stream doesn't close the socket.
+ */
+class TLSStream {
+
+    public:
+        TLSStream(Reactor& reactor, int fd, ConnectionEnd end);
+        ~TLSStream();
+
+    private:
+        TLSStream(const TLSStream& other);
+        TLSStream& operator= (const TLSStream& other);
+
+    public:
+        // Send a close_notify.
+        Task<void> close();
+        TLSConnection& getConnection() { return connection; }
+        Task<void> handshake();
+        // Get the plaintext of the next application data record. Returns
+        // false when the peer has closed the connection. The view is
+        // valid until the next read.
+        Task<bool> read(RecordView& plaintext);
+        Task<void> write(const uint8_t *data, unsigned length);
+
+    public:
+        // Sign server handshakes on the signer's threads.
+        static void setSigner(AsyncSigner *signer);
+
+    private:
+        Task<void> fill();
+        Task<void> flush();
+        Task<void> sign();
+
+    private:
+        Reactor& reactor;
+        int fd;
+        TLSConnection connection;
+
+        static AsyncSigner *signer;
+
+};
+
+}
+
+#endif  // _TLS_THREAD_LOCAL_
+#endif  // __cplusplus >= 202002L
+
+#endif  // TLSSTREAM_H_INCLUDED
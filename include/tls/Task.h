@@ -0,0 +1,129 @@
+#ifndef TASK_H_INCLUDED
+#define TASK_H_INCLUDED
+
+#if __cplusplus >= 202002L
+
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+namespace CKTLS {
+
+template<typename T> class Task;
+
+/*
+ * Promise state shared by all tasks. A finished task resumes the
+ * coroutine that awaited it directly, without growing the stack.
+ */
+class TaskPromiseBase {
+
+    public:
+        struct FinalAwaiter {
+            bool await_ready() const noexcept { return false; }
+            template<typename P>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+                std::coroutine_handle<> next = h.promise().continuation;
+                return next ? next : std::noop_coroutine();
+            }
+            void await_resume() const noexcept {}
+        };
+
+    public:
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        FinalAwaiter final_suspend() const noexcept { return {}; }
+        void unhandled_exception() { exception = std::current_exception(); }
+
+    public:
+        std::coroutine_handle<> continuation;
+        std::exception_ptr exception;
+
+};
+
+template<typename T>
+class TaskPromise : public TaskPromiseBase {
+
+    public:
+        Task<T> get_return_object();
+        void return_value(T v) { value = std::move(v); }
+        T result() {
+            if (exception) {
+                std::rethrow_exception(exception);
+            }
+            return std::move(value);
+        }
+
+    private:
+        T value;
+
+};
+
+template<>
+class TaskPromise<void> : public TaskPromiseBase {
+
+    public:
+        Task<void> get_return_object();
+        void return_void() {}
+        void result() {
+            if (exception) {
+                std::rethrow_exception(exception);
+            }
+        }
+
+};
+
+/*
+ * Lazily started coroutine. It runs when it is awaited, and the
+ * awaiting coroutine continues with its result, or its exception,
+ * when it finishes.
+ */
+template<typename T = void>
+class Task {
+
+    public:
+        typedef TaskPromise<T> promise_type;
+        typedef std::coroutine_handle<promise_type> Handle;
+
+    public:
+        explicit Task(Handle h) : handle(h) {}
+        Task(Task&& other) noexcept : handle(other.handle) { other.handle = 0; }
+        ~Task() {
+            if (handle) {
+                handle.destroy();
+            }
+        }
+
+    private:
+        Task(const Task& other);
+        Task& operator= (const Task& other);
+
+    public:
+        bool await_ready() const noexcept { return !handle || handle.done(); }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+            handle.promise().continuation = awaiting;
+            return handle;
+        }
+        T await_resume() { return handle.promise().result(); }
+
+    private:
+        Handle handle;
+
+};
+
+template<typename T>
+Task<T> TaskPromise<T>::get_return_object() {
+
+    return Task<T>(Task<T>::Handle::from_promise(*this));
+
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+
+    return Task<void>(Task<void>::Handle::from_promise(*this));
+
+}
+
+}
+
+#endif  // __cplusplus >= 202002L
+
+#endif  // TASK_H_INCLUDED
@@ -0,0 +1,76 @@
+#ifndef TICKETKEYRING_H_INCLUDED
+#define TICKETKEYRING_H_INCLUDED
+
+#include "SessionCache.h"
+#include "coder/ByteArray.h"
+#include <deque>
+#include <mutex>
+
+namespace CKTLS {
+
+class ConnectionState;
+
+/*
+ * Session ticket protection keys. See RFC 5077 Section 4.
+ *
+ * A new key is used for each rotation interval. Keys are derived
+ * from a ring secret and the interval number, so server processes
+ * configured with the same secret issue and accept each other's
+ * tickets without sharing any state. Keys are kept for as long as
+ * the tickets they sealed can be valid.
+ *
+ * Ticket format: key name (16) | IV (12) | AES-256-GCM sealed
+ * cipher suite (2), creation time (8) and master secret (48).
+ * The key name is authenticated as additional data.
+ */
+class TicketKeyRing {
+
+    public:
+        // Uses a random ring secret. Tickets only resume on this server.
+        TicketKeyRing(unsigned rotation = DEFAULT_ROTATION,
+                                    unsigned lifetime = DEFAULT_LIFETIME);
+        TicketKeyRing(const coder::ByteArray& secret,
+                                    unsigned rotation = DEFAULT_ROTATION,
+                                    unsigned lifetime = DEFAULT_LIFETIME);
+        ~TicketKeyRing();
+
+    private:
+        TicketKeyRing(const TicketKeyRing& other);
+        TicketKeyRing& operator= (const TicketKeyRing& other);
+
+    public:
+        // Ticket lifetime in seconds, for the NewSessionTicket hint.
+        unsigned getLifetime() const { return lifetime; }
+        // Decrypt a ticket. Returns false if the ticket is invalid or expired.
+        bool open(const coder::ByteArray& ticket, Session& session);
+        // Encrypt the master secret and suite of a negotiated state.
+        coder::ByteArray seal(const ConnectionState& state);
+
+    public:
+        static const unsigned DEFAULT_ROTATION;     // Seconds.
+        static const unsigned DEFAULT_LIFETIME;     // Seconds.
+        static const unsigned KEY_NAME_LENGTH;
+
+    private:
+        struct TicketKey {
+            uint64_t interval;
+            coder::ByteArray name;
+            coder::ByteArray key;
+        };
+        typedef std::deque<TicketKey> KeyList;
+
+    private:
+        void update(time_t now);
+
+    private:
+        coder::ByteArray secret;
+        unsigned rotation;
+        unsigned lifetime;
+        KeyList keys;           // Oldest first.
+        std::mutex lock;
+
+};
+
+}
+
+#endif  // TICKETKEYRING_H_INCLUDED